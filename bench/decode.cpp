@@ -0,0 +1,65 @@
+// Measures how quickly lodepng decodes the PNG textures used by createScene.
+// Run from the repository root: ./build/bench/decode [iterations] [file.png...]
+#include <lodepng.h>
+#include <util.h>
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    
+    std::vector<const char*> files;
+    for (int i = 2; i < argc; i++)
+        files.push_back(argv[i]);
+    if (files.empty())
+    {
+        files.push_back("textures/texture1.png");
+        files.push_back("textures/texture2.png");
+        files.push_back("textures/texture3.png");
+    }
+    
+    double totalSeconds = 0, totalBytes = 0;
+    
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        // keep file IO out of the measurement
+        unsigned char* png;
+        size_t pngSize;
+        if (lodepng_load_file(&png, &pngSize, files[f]))
+        {
+            std::cerr << "could not read " << files[f] << "\n";
+            return 1;
+        }
+        
+        unsigned width = 0, height = 0;
+        double start = now();
+        
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned char* image;
+            unsigned err = lodepng_decode24(&image, &width, &height, png, pngSize);
+            if (err)
+            {
+                std::cerr << files[f] << ": " << lodepng_error_text(err) << "\n";
+                return 1;
+            }
+            free(image);
+        }
+        
+        double seconds = (now() - start) / iterations;
+        double bytes = width * height * 3.0;
+        totalSeconds += seconds;
+        totalBytes += bytes;
+        
+        std::cout << files[f] << " (" << width << "x" << height << "): "
+                  << seconds * 1000 << " ms, " << bytes / seconds / 1e6 << " MB/s\n";
+        
+        free(png);
+    }
+    
+    std::cout << "total: " << totalSeconds * 1000 << " ms, "
+              << totalBytes / totalSeconds / 1e6 << " MB/s\n";
+}
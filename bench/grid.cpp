@@ -0,0 +1,112 @@
+// Compares drawing particle dumps, clouds of spheres of about the same size, through a
+// uniform grid and through a BVH: how long each takes to build, to draw the image, and
+// both together, for clouds of several sizes. Particles are either spread evenly through
+// a box, which suits a grid, or bunched into a few blobs, which suits it less.
+// Usage: ./build/bench/grid [width height]
+#include <grid.h>
+#include <trace.h>
+#include <util.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+
+static float random(float low, float high)
+{
+    return low + (high - low) * rand() / RAND_MAX;
+}
+
+// particles spheres in a 100 unit box in front of the camera, sized so clouds of any
+// number of them look about as dense, spread evenly or bunched into eight blobs
+static Scene* createParticles(int particles, bool bunched)
+{
+    Scene* scene = new Scene;
+    scene->viewPlaneTop = 1;
+    scene->viewPlaneBottom = -1;
+    scene->viewPlaneLeft = -1;
+    scene->viewPlaneRight = 1;
+    scene->viewPlaneZ = -1.5;
+    scene->backgroundColor = Color(0.1,0.1,0.2);
+    scene->ambientLight = Color(0.2,0.2,0.2);
+    
+    PointLight* light = new PointLight;
+    light->color = Color(0.8,0.8,0.8);
+    light->location = Point(60,80,0);
+    scene->pointLights.push_back(light);
+    
+    Material m;
+    m.ambient = m.diffuse = Color(0.3,0.5,0.9);
+    m.specular = Color(0.3,0.3,0.3);
+    m.shininess = 30;
+    
+    Point blobs[8];
+    for (int i = 0; i < 8; i++)
+        blobs[i] = Point(random(-40, 40), random(-40, 40), random(-140, -60));
+    
+    float radius = 15 / cbrtf(particles);
+    for (int i = 0; i < particles; i++)
+    {
+        Point p;
+        if (bunched)
+        {
+            // a rough normal distribution around one of the blobs
+            Point &blob = blobs[i % 8];
+            p = Point(blob.x + (random(-4, 4) + random(-4, 4) + random(-4, 4)),
+                      blob.y + (random(-4, 4) + random(-4, 4) + random(-4, 4)),
+                      blob.z + (random(-4, 4) + random(-4, 4) + random(-4, 4)));
+        }
+        else
+            p = Point(random(-50, 50), random(-50, 50), random(-150, -50));
+        scene->objects.push_back(new Sphere(m, p, radius * random(0.8, 1.2)));
+    }
+    return scene;
+}
+
+// builds an accelerator with make and draws the scene through it
+template<class Make>
+static void measure(const char* name, Scene* scene, Make make, vector<unsigned char> &image, int width,
+                    int height)
+{
+    double start = now();
+    Accelerator* accelerator = make();
+    double built = now() - start;
+    scene->accelerator = accelerator;
+    drawScene(scene, &image[0], width, height, 3, false, 1);
+    double total = now() - start;
+    scene->accelerator = NULL;
+    
+    std::cout << name << "built in " << std::setw(8) << built * 1000 << " ms, drawn in " << std::setw(8)
+              << (total - built) * 1000 << " ms, " << std::setw(8) << total * 1000 << " ms in all";
+    if (Grid* grid = dynamic_cast<Grid*>(accelerator))
+        std::cout << ", " << grid->resolution(0) << " x " << grid->resolution(1) << " x " << grid->resolution(2)
+                  << " cells";
+    std::cout << "\n";
+    delete accelerator;
+}
+
+int main(int argc, char** argv)
+{
+    int width = argc > 2 ? atoi(argv[1]) : 256;
+    int height = argc > 2 ? atoi(argv[2]) : 256;
+    std::cout << std::setprecision(4);
+    
+    int sizes[] = {10000, 100000, 1000000};
+    for (int bunched = 0; bunched < 2; bunched++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            std::cout << sizes[i] << " particles, " << (bunched ? "bunched" : "spread evenly") << ":\n";
+            Scene* scene = createParticles(sizes[i], bunched);
+            vector<unsigned char> bvhImage((size_t) width * height * 3), gridImage(bvhImage.size());
+            measure("  BVH:  ", scene, [&]() { return new BVH(scene); }, bvhImage, width, height);
+            measure("  grid: ", scene, [&]() { return new Grid(scene); }, gridImage, width, height);
+            std::cout << "  images are " << (bvhImage == gridImage ? "the same" : "different") << "\n";
+            
+            for (size_t j = 0; j < scene->objects.size(); j++)
+                delete scene->objects[j];
+            delete scene->pointLights[0];
+            delete scene;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+// Measures how long IncrementalRenderer takes to bring an image up to date after an
+// edit, compared with drawing the whole image again, in a room full of spheres. Each
+// edit is checked against a full drawScene of the edited scene.
+// Usage: ./build/bench/incremental [width height]
+#include <incremental.h>
+#include <util.h>
+#include "room.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+    int width = argc > 2 ? atoi(argv[1]) : 512;
+    int height = argc > 2 ? atoi(argv[2]) : 512;
+    
+    // matte walls, or every sphere shows up in reflections all over the room and any
+    // edit touches most tiles
+    Scene* scene = createRoomScene(2, false);
+    vector<unsigned char> image((size_t) width * height * 3), check(image.size());
+    IncrementalRenderer renderer(scene, &image[0], width, height, 5, false, 1);
+    
+    double start = now();
+    renderer.drawAll();
+    std::cout << "full image: " << std::setprecision(4) << (now() - start) * 1000 << " ms, "
+              << renderer.tileCount() << " tiles\n";
+    
+    // roll the front left sphere towards the middle, then move a light
+    GeometricObject* sphere = scene->objects[5];
+    for (int step = 0; step <= 4; step++)
+    {
+        const char* edit = "move sphere";
+        if (step < 4)
+        {
+            sphere->translate(Vector(0.25,0,0));
+            renderer.objectChanged(sphere);
+        }
+        else
+        {
+            edit = "move light";
+            scene->pointLights[0]->location.x -= 1;
+            renderer.lightChanged(scene->pointLights[0]);
+        }
+        
+        start = now();
+        int tiles = renderer.update();
+        double seconds = now() - start;
+        
+        drawScene(scene, &check[0], width, height, 5, false, 1);
+        bool same = memcmp(&image[0], &check[0], image.size()) == 0;
+        std::cout << std::setw(12) << edit << ": " << std::setw(4) << tiles << " tiles in "
+                  << std::setw(6) << std::setprecision(4) << seconds * 1000 << " ms"
+                  << (same ? "" : ", DIFFERENT FROM A FULL DRAW") << "\n";
+    }
+}
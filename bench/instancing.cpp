@@ -0,0 +1,127 @@
+// Compares a room full of glass tables built from separate rectangles for each table with
+// the same room built from instances of one table model, both drawn through a BVH: the
+// memory the tables take, how long the BVH takes to build and how long drawing takes.
+// Usage: ./build/bench/instancing [tables across [width height]]
+#include <instance.h>
+#include <trace.h>
+#include <util.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+static Material glassMaterial()
+{
+    Material glass;
+    glass.ambient = Color(0.1,0.1,0.1);
+    glass.diffuse = Color(0.1,0.1,0.1);
+    glass.specular = Color(0.35,0.35,0.35);
+    glass.refracted = Color(0.65,0.65,0.65);
+    glass.emission = Color(0,0,0);
+    glass.shininess = 1000;
+    return glass;
+}
+
+// the table of createScene, 4 wide, 2 high and 4 deep, with the middle of its top at at
+static void addTable(vector<GeometricObject*> &objects, Point at)
+{
+    Material glass = glassMaterial();
+    float x = at.x, y = at.y, z = at.z;
+    objects.push_back(new Rectangle(glass, x + 2, x - 2, y, y, z + 2, z - 2, Vector(0,1,0)));
+    objects.push_back(new Rectangle(glass, x + 2, x - 2, y, y - 2, z + 2, z + 2, Vector(0,0,1)));
+    objects.push_back(new Rectangle(glass, x + 2, x - 2, y, y - 2, z - 2, z - 2, Vector(0,0,-1)));
+    objects.push_back(new Rectangle(glass, x + 2, x + 2, y, y - 2, z + 2, z - 2, Vector(1,0,0)));
+    objects.push_back(new Rectangle(glass, x - 2, x - 2, y, y - 2, z + 2, z - 2, Vector(-1,0,0)));
+}
+
+// a room with a floor, a light and no tables yet
+static Scene* createRoom()
+{
+    Scene* scene = new Scene;
+    scene->viewPlaneTop = 10;
+    scene->viewPlaneBottom = -10;
+    scene->viewPlaneLeft = -10;
+    scene->viewPlaneRight = 10;
+    scene->viewPlaneZ = -20;
+    scene->backgroundColor = Color(0,0,0);
+    scene->ambientLight = Color(0.2,0.2,0.2);
+    
+    PointLight* light = new PointLight;
+    light->color = Color(0.8,0.8,0.8);
+    light->location = Point(0,30,-40);
+    scene->pointLights.push_back(light);
+    
+    Material floor = glassMaterial();
+    floor.ambient = floor.diffuse = Color(0,0.5,0.5);
+    floor.specular = floor.refracted = Color(0,0,0);
+    scene->objects.push_back(new Plane(floor, Point(0,-12,0), Vector(0,1,0)));
+    return scene;
+}
+
+// where the table in row i, column j of a grid of tables goes
+static Point tablePosition(int i, int j, int across)
+{
+    return Point(-5 * (across - 1) / 2.0f + 5 * j, -10, -25 - 5 * i);
+}
+
+static int maxDifference(const vector<unsigned char> &a, const vector<unsigned char> &b)
+{
+    int largest = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        largest = std::max(largest, std::abs(a[i] - b[i]));
+    return largest;
+}
+
+// builds the BVH of a scene and draws it, printing how long that took
+static void draw(const char* name, Scene* scene, size_t tableBytes, vector<unsigned char> &image, int width,
+                 int height)
+{
+    double start = now();
+    BVH bvh(scene);
+    double built = now() - start;
+    scene->accelerator = &bvh;
+    
+    start = now();
+    drawScene(scene, &image[0], width, height, 5, false, 1);
+    double drawn = now() - start;
+    scene->accelerator = NULL;
+    
+    std::cout << name << std::setw(8) << scene->objects.size() << " objects, " << std::setw(10) << tableBytes
+              << " bytes of tables, BVH built in " << std::setw(8) << built * 1000 << " ms, drawn in "
+              << std::setw(8) << drawn * 1000 << " ms\n";
+}
+
+int main(int argc, char** argv)
+{
+    int across = argc > 1 ? atoi(argv[1]) : 20;
+    int width = argc > 3 ? atoi(argv[2]) : 256;
+    int height = argc > 3 ? atoi(argv[3]) : 256;
+    std::cout << std::setprecision(4);
+    
+    Scene* copies = createRoom();
+    for (int i = 0; i < across; i++)
+    {
+        for (int j = 0; j < across; j++)
+            addTable(copies->objects, tablePosition(i, j, across));
+    }
+    size_t copyBytes = (size_t) across * across * 5 * sizeof(Rectangle);
+    
+    vector<GeometricObject*> table;
+    addTable(table, Point(0,0,0));
+    Model model(table);
+    Scene* instances = createRoom();
+    for (int i = 0; i < across; i++)
+    {
+        for (int j = 0; j < across; j++)
+        {
+            Point at = tablePosition(i, j, across);
+            instances->objects.push_back(new Instance(&model, Vector(at.x, at.y, at.z)));
+        }
+    }
+    size_t instanceBytes = sizeof(Model) + 5 * sizeof(Rectangle) + (size_t) across * across * sizeof(Instance);
+    
+    vector<unsigned char> copyImage((size_t) width * height * 3), instanceImage(copyImage.size());
+    draw("copies:   ", copies, copyBytes, copyImage, width, height);
+    draw("instances:", instances, instanceBytes, instanceImage, width, height);
+    std::cout << "images differ by up to " << maxDifference(copyImage, instanceImage) << "\n";
+}
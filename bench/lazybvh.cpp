@@ -0,0 +1,84 @@
+// Compares building a BVH before drawing with building it as rays need it (LazyBVH), on
+// a field of spheres stretching far beyond what the camera sees: how long it takes until
+// a 64 x 64 tile at the bottom middle of the image, where the field is, is drawn, and
+// until the whole image is, counting the build.
+// Usage: ./build/bench/lazybvh [spheres [width height]]
+#include <lazybvh.h>
+#include <trace.h>
+#include <util.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+static float random(float low, float high)
+{
+    return low + (high - low) * rand() / RAND_MAX;
+}
+
+// spheres scattered over a 2000 x 2000 square below and in front of the camera, which
+// sees a narrow wedge of it
+static Scene* createField(int spheres)
+{
+    Scene* scene = new Scene;
+    scene->viewPlaneTop = 2;
+    scene->viewPlaneBottom = -2;
+    scene->viewPlaneLeft = -2;
+    scene->viewPlaneRight = 2;
+    scene->viewPlaneZ = -20;
+    scene->backgroundColor = Color(0.1,0.1,0.2);
+    scene->ambientLight = Color(0.2,0.2,0.2);
+    
+    PointLight* light = new PointLight;
+    light->color = Color(0.8,0.8,0.8);
+    light->location = Point(0,50,0);
+    scene->pointLights.push_back(light);
+    
+    Material m;
+    m.ambient = m.diffuse = Color(0.8,0.4,0.2);
+    m.specular = Color(0.2,0.2,0.2);
+    m.shininess = 20;
+    for (int i = 0; i < spheres; i++)
+        scene->objects.push_back(new Sphere(m, Point(random(-1000, 1000), random(-12, -4), random(-2000, 0)),
+                                            random(0.5, 2)));
+    return scene;
+}
+
+// draws the tile and then the whole image with an accelerator made by make, timing both
+// from the start of the build
+template<class Make>
+static void measure(const char* name, Scene* scene, Make make, vector<unsigned char> &image, int width,
+                    int height)
+{
+    vector<unsigned char> tile(64 * 64 * 3);
+    double start = now();
+    Accelerator* accelerator = make();
+    double built = now() - start;
+    scene->accelerator = accelerator;
+    drawSceneTile(scene, &tile[0], width, height, width / 2 - 32, height - 64, 64, 64, 3, false, 1);
+    double firstTile = now() - start;
+    drawScene(scene, &image[0], width, height, 3, false, 1);
+    double total = now() - start;
+    scene->accelerator = NULL;
+    
+    std::cout << name << "built in " << std::setw(8) << built * 1000 << " ms, first tile after " << std::setw(8)
+              << firstTile * 1000 << " ms, whole image after " << std::setw(8) << total * 1000 << " ms";
+    if (LazyBVH* lazy = dynamic_cast<LazyBVH*>(accelerator))
+        std::cout << ", " << lazy->nodesBuilt() << " of " << 2 * scene->objects.size() - 1 << " nodes at most built";
+    std::cout << "\n";
+    delete accelerator;
+}
+
+int main(int argc, char** argv)
+{
+    int spheres = argc > 1 ? atoi(argv[1]) : 500000;
+    int width = argc > 3 ? atoi(argv[2]) : 256;
+    int height = argc > 3 ? atoi(argv[3]) : 256;
+    std::cout << std::setprecision(4);
+    
+    Scene* scene = createField(spheres);
+    vector<unsigned char> eager((size_t) width * height * 3), lazy(eager.size());
+    measure("BVH:     ", scene, [&]() { return new BVH(scene); }, eager, width, height);
+    measure("LazyBVH: ", scene, [&]() { return new LazyBVH(scene); }, lazy, width, height);
+    std::cout << "images are " << (eager == lazy ? "the same" : "different") << "\n";
+}
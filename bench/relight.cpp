@@ -0,0 +1,83 @@
+// Measures how long Relighter takes to redraw an image after the point lights changed,
+// compared with drawing the whole image again, in a room with shiny and glass spheres.
+// Each redraw is compared with a full drawScene of the changed scene.
+// Usage: ./build/bench/relight [width height]
+#include <relight.h>
+#include <util.h>
+#include "room.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+// the room with three lights and shiny walls, and a glass sphere in front of the rows
+// of spheres, so the lights also reach the image through reflections and refractions
+static Scene* createGlassRoomScene()
+{
+    Scene* scene = createRoomScene(3, true);
+    Material glass = shiny(Color(0,0,0));
+    glass.specular = Color(0.1,0.1,0.1);
+    glass.refracted = Color(0.8,0.8,0.8);
+    scene->objects.push_back(new Sphere(glass, Point(0,-4,-25), 2));
+    return scene;
+}
+
+// the largest difference between two images in any channel
+static int maxDifference(const vector<unsigned char> &a, const vector<unsigned char> &b)
+{
+    int largest = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        largest = std::max(largest, std::abs(a[i] - b[i]));
+    return largest;
+}
+
+int main(int argc, char** argv)
+{
+    int width = argc > 2 ? atoi(argv[1]) : 512;
+    int height = argc > 2 ? atoi(argv[2]) : 512;
+    
+    Scene* scene = createGlassRoomScene();
+    vector<unsigned char> image((size_t) width * height * 3), check(image.size());
+    Relighter relighter(scene, width, height, 5, false, 1);
+    
+    double start = now();
+    drawScene(scene, &check[0], width, height, 5, false, 1);
+    std::cout << "drawScene:    " << std::setw(8) << std::setprecision(4) << (now() - start) * 1000 << " ms\n";
+    
+    start = now();
+    relighter.drawAll();
+    relighter.draw(&image[0]);
+    std::cout << "drawAll:      " << std::setw(8) << (now() - start) * 1000 << " ms, off by up to "
+              << maxDifference(image, check) << "\n";
+    
+    for (int step = 0; step < 3; step++)
+    {
+        const char* edit = "light color: ";
+        PointLight* light = scene->pointLights[1];
+        
+        start = now();
+        if (step == 0)
+            light->color = Color(0.6,0.3,0.2);
+        else if (step == 1)
+        {
+            edit = "move light:  ";
+            light->location.x += 2;
+            relighter.lightChanged(light);
+        }
+        else
+        {
+            edit = "add light:   ";
+            light = new PointLight;
+            light->color = Color(0.2,0.2,0.3);
+            light->location = Point(0,5,-22);
+            scene->pointLights.push_back(light);
+            relighter.lightChanged(light);
+        }
+        relighter.draw(&image[0]);
+        double seconds = now() - start;
+        
+        drawScene(scene, &check[0], width, height, 5, false, 1);
+        std::cout << edit << std::setw(8) << seconds * 1000 << " ms, off by up to "
+                  << maxDifference(image, check) << "\n";
+    }
+}
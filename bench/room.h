@@ -0,0 +1,58 @@
+// This file defines the room of spheres the incremental and relight benchmarks draw.
+#ifndef BENCH_ROOM_H
+#define BENCH_ROOM_H
+
+#include <trace.h>
+
+static Material shiny(Color c)
+{
+    Material m;
+    m.ambient = c;
+    m.diffuse = c;
+    m.specular = Color(0.3,0.3,0.3);
+    m.refracted = Color(0,0,0);
+    m.emission = Color(0,0,0);
+    m.shininess = 20;
+    return m;
+}
+
+// a room with lights point lights in a row under the ceiling and rows of shiny spheres
+// on the floor. with shiny walls, every sphere shows up in reflections all over the room.
+static Scene* createRoomScene(int lights, bool shinyWalls)
+{
+    Scene* scene = new Scene;
+    scene->viewPlaneTop = 10;
+    scene->viewPlaneBottom = -10;
+    scene->viewPlaneLeft = -10;
+    scene->viewPlaneRight = 10;
+    scene->viewPlaneZ = -20;
+    scene->backgroundColor = Color(0,0,0);
+    scene->ambientLight = Color(0.2,0.2,0.2);
+    
+    for (int i = 0; i < lights; i++)
+    {
+        PointLight* light = new PointLight;
+        light->color = Color(1.0f / lights, 1.0f / lights, 1.0f / lights);
+        light->location = Point(lights > 1 ? -5 + 10.0f * i / (lights - 1) : 0, 9, -30);
+        scene->pointLights.push_back(light);
+    }
+    
+    Material wall = shiny(Color(0.4,0.6,0.6));
+    if (!shinyWalls)
+        wall.specular = Color(0,0,0);
+    scene->objects.push_back(new Plane(wall, Point(0,-10,0), Vector(0,1,0)));
+    scene->objects.push_back(new Plane(wall, Point(0,10,0), Vector(0,-1,0)));
+    scene->objects.push_back(new Plane(wall, Point(-10,0,0), Vector(1,0,0)));
+    scene->objects.push_back(new Plane(wall, Point(10,0,0), Vector(-1,0,0)));
+    scene->objects.push_back(new Plane(wall, Point(0,0,-50), Vector(0,0,1)));
+    
+    for (int i = 0; i < 24; i++)
+    {
+        Point center(-7.5 + (i % 6) * 3, -9, -28 - (i / 6) * 5);
+        scene->objects.push_back(new Sphere(shiny(Color(0.2 + 0.03 * i, 0.3, 0.9 - 0.03 * i)), center, 1));
+    }
+    
+    return scene;
+}
+
+#endif
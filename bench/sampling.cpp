@@ -0,0 +1,147 @@
+// Compares the sample patterns and pixel filters by how far their images are from a
+// reference image drawn with many rays per pixel, for a scene full of sharp edges.
+// Times are the real cost: the shared-sample filters trace about antialias^2 rays
+// per pixel, plus a few lattice rows twice where bands meet. The reference is box
+// filtered, so the wider filters level off at the difference their blur makes. The
+// +edges rows draw one ray per pixel and redraw only the pixels on edges.
+// Usage: ./build/bench/sampling [width height]
+#include <trace.h>
+#include <denoise.h>
+#include <util.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+
+static Material matte(Color c)
+{
+    Material m;
+    m.ambient = c;
+    m.diffuse = c;
+    m.specular = Color(0.2,0.2,0.2);
+    m.refracted = Color(0,0,0);
+    m.emission = Color(0,0,0);
+    m.shininess = 10;
+    return m;
+}
+
+// spheres of all sizes and thin frames in front of a wall, like the silhouettes and
+// picture frames of the default scene
+static Scene* createEdgeScene()
+{
+    Scene* scene = new Scene;
+    scene->viewPlaneTop = 10;
+    scene->viewPlaneBottom = -10;
+    scene->viewPlaneLeft = -10;
+    scene->viewPlaneRight = 10;
+    scene->viewPlaneZ = -20;
+    scene->backgroundColor = Color(0,0,0);
+    scene->ambientLight = Color(0.2,0.2,0.2);
+    
+    PointLight* light = new PointLight;
+    light->color = Color(0.8,0.8,0.8);
+    light->location = Point(5,8,-20);
+    scene->pointLights.push_back(light);
+    
+    scene->objects.push_back(new Plane(matte(Color(0.9,0.9,0.9)), Point(0,0,-60), Vector(0,0,1)));
+    
+    for (int i = 0; i < 12; i++)
+    {
+        float radius = 0.3 + 0.25 * i;
+        Point center(-14 + (i % 4) * 9, -12 + (i / 4) * 10, -40 - i);
+        scene->objects.push_back(new Sphere(matte(Color(0.2 + 0.06 * i, 0.3, 0.9 - 0.06 * i)), center, radius));
+    }
+    
+    // frames: thin, slightly tilted bars are the hardest case for a regular grid
+    for (int i = 0; i < 6; i++)
+    {
+        float x = -15 + i * 6;
+        scene->objects.push_back(new Rectangle(matte(Color(0.6,0.4,0.1)), x + 0.3, x, 15, -15, -45, -45,
+                                               Vector(0,0,1)));
+        float y = -15 + i * 6 + 0.1 * i;
+        scene->objects.push_back(new Rectangle(matte(Color(0.1,0.5,0.2)), 15, -15, y + 0.2, y, -44, -44,
+                                               Vector(0,0,1)));
+    }
+    
+    return scene;
+}
+
+// returns the rays traced per pixel; with edgeAntialias set the image is drawn with
+// one ray per pixel, then the edges are redrawn at that factor and the result denoised
+static double draw(Scene* scene, vector<float> &image, int width, int height, int antialias, SamplePattern pattern,
+                   PixelFilter filter = BOX_FILTER, int edgeAntialias = 0)
+{
+    image.resize((size_t) width * height * 3);
+    double rays = antialias * antialias;
+    
+    if (edgeAntialias)
+    {
+        size_t pixels = (size_t) width * height;
+        vector<float> depth(pixels), normal(pixels * 3), objectId(pixels), albedo(pixels * 3);
+        RenderOutputs guides = {&depth[0], &normal[0], &objectId[0], &albedo[0]};
+        
+        // the guides take a second ray through each pixel center
+        drawSceneHDR(scene, &image[0], width, height, 2, false, 1, &guides, pattern, filter);
+        int edges = redrawEdges(scene, &image[0], width, height, guides, 2, false, edgeAntialias, pattern);
+        denoise(&image[0], width, height, guides);
+        rays = 2 + (double) edges * edgeAntialias * edgeAntialias / pixels;
+    }
+    else
+        drawSceneHDR(scene, &image[0], width, height, 2, false, antialias, NULL, pattern, filter);
+    
+    // compare what ends up in the png
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = std::min(std::max(image[i], 0.0f), 1.0f);
+    
+    return rays;
+}
+
+int main(int argc, char** argv)
+{
+    int width = argc > 2 ? atoi(argv[1]) : 160;
+    int height = argc > 2 ? atoi(argv[2]) : 120;
+    
+    Scene* scene = createEdgeScene();
+    
+    // 256 jittered rays per pixel converge to the true pixel average without the bias
+    // a regular grid would give edges at particular angles
+    vector<float> reference;
+    draw(scene, reference, width, height, 16, JITTERED_SAMPLES);
+    
+    // the +edges rows use antialias as the factor the edges are redrawn at
+    const char* names[] = {"regular", "jittered", "rotated grid", "halton", "sobol", "tent", "mitchell",
+                           "regular+edges", "sobol+edges"};
+    const SamplePattern patterns[] = {REGULAR_SAMPLES, JITTERED_SAMPLES, ROTATED_GRID_SAMPLES,
+                                      HALTON_SAMPLES, SOBOL_SAMPLES, REGULAR_SAMPLES, REGULAR_SAMPLES,
+                                      REGULAR_SAMPLES, SOBOL_SAMPLES};
+    const PixelFilter filters[] = {BOX_FILTER, BOX_FILTER, BOX_FILTER, BOX_FILTER, BOX_FILTER,
+                                   TENT_FILTER, MITCHELL_FILTER, BOX_FILTER, BOX_FILTER};
+    
+    std::cout << std::setw(14) << "pattern" << std::setw(8) << "aa" << std::setw(8) << "rays"
+              << std::setw(12) << "rmse" << std::setw(12) << "ms" << "\n";
+    
+    for (int p = 0; p < 9; p++)
+    {
+        for (int antialias = 1; antialias <= 4; antialias++)
+        {
+            if (p >= 7 && antialias == 1)
+                continue;
+            
+            vector<float> image;
+            double start = now();
+            double rays = draw(scene, image, width, height, antialias, patterns[p], filters[p],
+                               p >= 7 ? antialias : 0);
+            double seconds = now() - start;
+            
+            double sum = 0;
+            for (size_t i = 0; i < image.size(); i++)
+                sum += (image[i] - reference[i]) * (image[i] - reference[i]);
+            
+            std::cout << std::setw(14) << names[p] << std::setw(8) << antialias
+                      << std::setw(8) << std::setprecision(3) << rays
+                      << std::setw(12) << std::setprecision(4) << sqrt(sum / image.size())
+                      << std::setw(12) << std::setprecision(4) << seconds * 1000 << "\n";
+        }
+    }
+}
@@ -0,0 +1,98 @@
+// Measures how many rays a second find their first hit among a cloud of spheres and
+// small rectangles, trying every object, through a BVH and through four- and eight-wide
+// BVHs, along with how long each takes to build and the memory it takes per object.
+// Every ray's hit is checked against the BVH's, and trying every object checks those
+// for the rays it does.
+// Usage: ./build/bench/widebvh [objects [rays]]
+#include <widebvh.h>
+#include <trace.h>
+#include <util.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+static float random(float low, float high)
+{
+    return low + (high - low) * rand() / RAND_MAX;
+}
+
+// objects spheres and rectangles scattered through a 100 unit cube in front of the origin
+static Scene* createCloud(int objects)
+{
+    Scene* scene = new Scene;
+    Material m;
+    for (int i = 0; i < objects; i++)
+    {
+        Point p(random(-50, 50), random(-50, 50), random(-130, -30));
+        if (i % 4)
+            scene->objects.push_back(new Sphere(m, p, random(0.2, 1)));
+        else
+            scene->objects.push_back(new Rectangle(m, p.x + 1, p.x, p.y, p.y, p.z + 1, p.z, Vector(0,1,0)));
+    }
+    return scene;
+}
+
+// the object each ray hits, or NULL
+static void trace(Scene* scene, vector<Ray> &rays, vector<GeometricObject*> &hits)
+{
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        Intersection* hit = findFirstIntersection(scene, &rays[i]);
+        hits[i] = hit ? hit->object : NULL;
+        delete hit;
+    }
+}
+
+// traces the rays through an accelerator, or by trying every object without one
+static void measure(const char* name, Scene* scene, Accelerator* accelerator, double buildSeconds,
+                    size_t memory, vector<Ray> &rays, const vector<GeometricObject*> &expected)
+{
+    scene->accelerator = accelerator;
+    vector<GeometricObject*> hits(rays.size());
+    double start = now();
+    trace(scene, rays, hits);
+    double seconds = now() - start;
+    scene->accelerator = NULL;
+    
+    int wrong = 0;
+    for (size_t i = 0; i < rays.size(); i++)
+        wrong += hits[i] != expected[i];
+    
+    std::cout << name << std::setw(8) << rays.size() / seconds / 1e6 << " Mrays/s, built in " << std::setw(8)
+              << buildSeconds * 1000 << " ms, " << std::setw(6) << (double) memory / scene->objects.size()
+              << " bytes per object, " << wrong << " rays wrong\n";
+}
+
+int main(int argc, char** argv)
+{
+    int objects = argc > 1 ? atoi(argv[1]) : 10000;
+    int count = argc > 2 ? atoi(argv[2]) : 200000;
+    std::cout << std::setprecision(4);
+    
+    Scene* scene = createCloud(objects);
+    vector<Ray> rays(count);
+    for (int i = 0; i < count; i++)
+        rays[i] = Ray(Point(0,0,0), Vector(random(-0.4, 0.4), random(-0.4, 0.4), -1).normalize());
+    
+    double start = now();
+    BVH bvh(scene);
+    double buildSeconds = now() - start;
+    vector<GeometricObject*> expected(count);
+    scene->accelerator = &bvh;
+    trace(scene, rays, expected);
+    scene->accelerator = NULL;
+    
+    // trying every object is slow, so it only does about as many rays as take a few seconds
+    vector<Ray> some(rays.begin(), rays.begin() + std::min(count, std::max(100, 20000000 / objects)));
+    measure("every object: ", scene, NULL, 0, 0, some, expected);
+    measure("BVH:          ", scene, &bvh, buildSeconds, bvh.memoryUsed(), rays, expected);
+    
+    start = now();
+    BVH4 bvh4(scene);
+    measure("BVH4:         ", scene, &bvh4, now() - start, bvh4.memoryUsed(), rays, expected);
+    
+    start = now();
+    BVH8 bvh8(scene);
+    measure("BVH8:         ", scene, &bvh8, now() - start, bvh8.memoryUsed(), rays, expected);
+}
@@ -0,0 +1,41 @@
+// This file defines drawing against a deadline, lowering the quality of tiles as needed.
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <trace.h>
+
+// what drawSceneWithDeadline actually achieved
+struct QualityReport {
+    // how long drawing took, in seconds
+    double seconds;
+    int tileCount;
+    // tiles drawn with the requested antialiasing factor and depth
+    int fullQualityTiles;
+    // the lowest and highest antialiasing factor and depth any tile was drawn with
+    int minAntialias, maxAntialias;
+    int minDepth, maxDepth;
+    // antialiasing samples per pixel, averaged over the image
+    double averageSamples;
+};
+
+/**
+ * Draws a scene into buffer like drawScene, but aims to be done timeBudget seconds
+ * after it is called. The image is drawn on all cores in tiles of tileSize pixels,
+ * visited in an order spread over the whole image. Before each tile, the time left is
+ * divided among the tiles left, and the tile gets the best quality that is expected to
+ * fit into its share, according to how long the tiles drawn so far took.
+ *
+ * Quality levels go from depth 1 without antialiasing, through increasing depths up
+ * to maxDepth, then increasing antialiasing factors up to antialiasFactor. One tile is
+ * drawn at the lowest level first, to measure the cost of a ray, and kept in the image.
+ * Once the budget is used up, the remaining tiles are drawn at the lowest level, so the
+ * render can overrun by about that much.
+ *
+ * If tileSize, width or height isn't positive, nothing is drawn and the report has no
+ * tiles.
+ */
+QualityReport drawSceneWithDeadline(Scene* s, unsigned char* buffer, int width, int height, int maxDepth,
+                                    bool orthographic, int antialiasFactor, double timeBudget, int tileSize = 32,
+                                    SamplePattern pattern = REGULAR_SAMPLES);
+
+#endif
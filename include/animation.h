@@ -0,0 +1,76 @@
+// This file defines keyframed animation of the objects and lights of a scene.
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <trace.h>
+
+// where something is at a time, as an offset from where it was when it was first keyed
+struct Keyframe {
+    float time;
+    Vector offset;
+};
+
+/**
+ * Moves objects and point lights of a scene along keyframes. Between two keyframes
+ * they move in a straight line at a steady speed; before the first keyframe they stay
+ * at the first one and after the last at the last. Objects are moved with translate,
+ * which is the only way they can be moved.
+ */
+class Animation
+{
+    public:
+        // keyframes can be added in any order, but only before the first setTime
+        void moveObject(GeometricObject* object, float time, Vector offset);
+        void moveLight(PointLight* light, float time, Vector offset);
+        
+        // puts everything keyed where it is at time
+        void setTime(float time);
+        // the time of the last keyframe
+        float duration();
+    
+    private:
+        // the keyframes of an object or a light
+        struct Track {
+            GeometricObject* object;
+            PointLight* light;
+            // where the light was without any offset
+            Point lightOrigin;
+            vector<Keyframe> keys;
+            // the offset the thing was moved by last
+            Vector offset;
+        };
+        
+        vector<Track> tracks;
+        
+        Track &track(GeometricObject* object, PointLight* light);
+};
+
+// what drawing one frame of an animation took
+struct FrameTimings {
+    // building or refitting the BVH for the frame
+    double bvhSeconds;
+    bool rebuilt;
+    double renderSeconds;
+    double encodeSeconds;
+    bool written;
+};
+
+/**
+ * Draws frames images of a scene as animation moves it, evenly spread from time 0 to
+ * its duration, into pngs named like outputFile with the frame number before the
+ * extension (raytrace0000.png, ...).
+ *
+ * The scene is drawn through a BVH built for the first frame and refitted to where the
+ * objects are for each frame after, until refitting has slowed it by rebuildRatio and
+ * it is built again (see bvh.h). The scene's own accelerator isn't used. The scene is
+ * left as it is at the last frame, with that frame's BVH as its accelerator, since one
+ * built before would no longer fit the objects. The caller deletes the BVH, and the
+ * accelerator the scene had before if any.
+ *
+ * Returns whether every frame was written. timings, if not NULL, gets one entry per frame.
+ */
+bool drawKeyframes(Scene* s, Animation &animation, int frames, const char* outputFile, int width, int height,
+                   int maxDepth, bool orthographic, int antialiasFactor, SamplePattern pattern = REGULAR_SAMPLES,
+                   float rebuildRatio = 1.5f, vector<FrameTimings>* timings = NULL);
+
+#endif
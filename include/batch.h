@@ -0,0 +1,62 @@
+// This file defines drawing one scene from several cameras in one go.
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <trace.h>
+
+#include <string>
+
+// a camera to draw a scene from, with the same meaning as the camera fields of Scene
+struct View {
+    Point viewpoint;
+    Vector viewRight, viewUp;
+    float viewPlaneTop, viewPlaneBottom, viewPlaneLeft, viewPlaneRight, viewPlaneZ;
+    // what goes before the extension of the output file name for this view
+    std::string name;
+    
+    // the camera a scene has now
+    View(Scene* s, std::string name);
+    
+    // points the camera of s this way
+    void apply(Scene* s) const;
+};
+
+// count views from points on a circle around center, level with the scene's viewpoint
+// and as far from center, all looking at center. the first one is the scene's own
+// viewpoint (turned towards center), and they go around clockwise seen from above.
+// they are numbered like the frames of an animation (0000, 0001, ...).
+vector<View> turntableViews(Scene* s, Point center, int count);
+
+// the views of a left and a right eye, separation apart across the scene's camera and
+// named -left and -right
+vector<View> stereoViews(Scene* s, float separation);
+
+// six views from the scene's viewpoint along the axes (+x, -x, +y, -y, +z, -z), each
+// seeing 90 degrees across, for the faces of a cube map. they are named -px, -nx, -py,
+// -ny, -pz and -nz. draw them into square images.
+vector<View> cubeMapViews(Scene* s);
+
+// what drawing one view took
+struct ViewTimings {
+    // from starting the view to its last tile, while other views were drawn too
+    double renderSeconds;
+    double encodeSeconds;
+    bool written;
+};
+
+/**
+ * Draws a scene from each of views into its own png, named like outputFile with the
+ * view's name before the extension.
+ *
+ * The scene, with its textures, is shared by all the views, which only get their own
+ * camera. A RenderPool draws two views at a time with all cores, tile by tile, while
+ * the calling thread writes out each view as soon as it is done, so encoding one image
+ * overlaps drawing the next. Images are identical to drawScene's.
+ *
+ * Returns whether every file was written. timings, if not NULL, gets one entry per view.
+ */
+bool drawViews(Scene* s, const vector<View> &views, const char* outputFile, int width, int height, int maxDepth,
+               bool orthographic, int antialiasFactor, SamplePattern pattern = REGULAR_SAMPLES,
+               vector<ViewTimings>* timings = NULL);
+
+#endif
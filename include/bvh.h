@@ -0,0 +1,193 @@
+// This file defines a bounding volume hierarchy over the objects of a scene.
+#ifndef BVH_H
+#define BVH_H
+
+#include <scene.h>
+
+#include <algorithm>
+#include <cmath>
+
+// objects a leaf holds before splitting it is worth trying
+#define BVH_LEAF_SIZE 4
+// the deepest a hierarchy gets, which bounds the stack a ray needs
+#define BVH_MAX_DEPTH 64
+
+/**
+ * A binary tree of boxes around the objects of a scene, split where the surface area
+ * heuristic (SAH) says rays will try the fewest objects. Planes and anything else
+ * without finite bounds are kept out of the tree and tried by every ray. Each box is a
+ * little larger than what it holds, so rounding never makes a ray miss a box around an
+ * object it hits, and rays find exactly what trying every object in order would. (The
+ * one exception is a ray from thousands of units away, for which an object's own test
+ * can be lost in rounding and find hits well outside the object.)
+ *
+ * When objects move, refit grows and shrinks the boxes around them where they are now
+ * without changing the tree, which is much quicker than building it again but makes it
+ * worse the further objects move from where they were when it was built. update refits
+ * and builds again once the tree's SAH cost has grown past rebuildRatio times what it
+ * was after building.
+ */
+class BVH : public Accelerator
+{
+    public:
+        // builds a tree over the objects s has now. it must be built again after adding
+        // or removing objects.
+        BVH(Scene* s, float rebuildRatio = 1.5f);
+        
+        void build();
+        void refit();
+        // refits, and builds again if that made the tree too slow. returns whether it did.
+        bool update();
+        
+        // the SAH cost of the tree as it is: the number of boxes and objects a ray going
+        // anywhere through the root box is expected to try, besides the unbounded objects
+        float cost();
+        
+        virtual Intersection* findFirstIntersection(Ray* r);
+        
+        // the bytes the tree takes
+        size_t memoryUsed();
+    
+    private:
+        // a leaf holds the count objects from order[first], and a branch has count zero,
+        // its first child right after it and its second at first
+        struct Node {
+            Bounds bounds;
+            int first, count;
+        };
+        
+        Scene* scene;
+        float rebuildRatio;
+        // the cost right after the last build
+        float builtCost;
+        vector<Node> nodes;
+        // the indices in scene->objects of the objects in the tree, leaf by leaf
+        vector<int> order;
+        vector<int> unbounded;
+        // the padded box around each object, by its index in scene->objects
+        vector<Bounds> objectBounds;
+        
+        void findObjectBounds();
+        int buildNode(int first, int count, int depth);
+        
+        template<int Width> friend class WideBVH;
+};
+
+// the box a BVH keeps around object, a little larger than the object's own
+Bounds paddedBounds(GeometricObject* object);
+// whether a box goes on forever along some axis
+bool isUnbounded(const Bounds &b);
+
+// sorts the count objects whose indices are at objects, which fit in bounds, into two
+// groups where the SAH says to split them, using their boxes in objectBounds, and
+// returns how many are in the first group, or 0 if they are better kept together
+int partitionObjects(int* objects, int count, const vector<Bounds> &objectBounds, const Bounds &bounds);
+
+// tries object number index of s->objects for r, keeping the closest intersection in
+// closest and the number of its object in closestIndex. of equally close ones the one
+// first in s->objects is kept, as it is when trying every object in order.
+void tryObject(Scene* s, int index, Ray* r, Intersection* &closest, int &closestIndex);
+
+// the surface area of a box
+inline float area(const Bounds &b)
+{
+    float dx = b.max.x - b.min.x, dy = b.max.y - b.min.y, dz = b.max.z - b.min.z;
+    return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+// the coordinate of a point along axis (XAXIS, YAXIS or ZAXIS)
+inline float coordinate(const Point &p, int axis)
+{
+    return axis == XAXIS ? p.x : axis == YAXIS ? p.y : p.z;
+}
+
+// the distance along a ray to where it enters a box, if it does before limit, and
+// INFINITY otherwise. inverse holds the reciprocals of the ray's direction.
+inline float enterBox(const Bounds &b, const Point &origin, const Vector &inverse, float limit)
+{
+    float t1 = (b.min.x - origin.x) * inverse.x, t2 = (b.max.x - origin.x) * inverse.x;
+    float near = std::min(t1, t2), far = std::max(t1, t2);
+    t1 = (b.min.y - origin.y) * inverse.y;
+    t2 = (b.max.y - origin.y) * inverse.y;
+    near = std::max(near, std::min(t1, t2));
+    far = std::min(far, std::max(t1, t2));
+    t1 = (b.min.z - origin.z) * inverse.z;
+    t2 = (b.max.z - origin.z) * inverse.z;
+    near = std::max(near, std::min(t1, t2));
+    far = std::min(far, std::max(t1, t2));
+    
+    if (near > far || far < 0 || near > limit)
+        return INFINITY;
+    return near;
+}
+
+// the reciprocal of a direction coordinate, huge instead of infinite for zero so that a
+// ray starting right on the side of a box doesn't multiply zero by infinity
+inline float reciprocal(float d)
+{
+    return d != 0 ? 1 / d : copysignf(1e30f, d);
+}
+
+// finds what r hits first among the objects of a binary tree of boxes, keeping it in
+// closest and closestIndex as tryObject does, visiting the nearer child of each branch
+// first and only boxes r enters before the closest hit so far. node i's box is
+// nodes[i].bounds, a leaf holds the nodes[i].count objects whose indices are from
+// order[nodes[i].first], and children(i, a, b) loads the two children of node i into
+// a and b, or returns false if it is a leaf. node 0 is the root.
+template<class Node, class Children>
+void findInTree(Scene* s, Ray* r, Node* nodes, const int* order, Children children, Intersection* &closest,
+                int &closestIndex)
+{
+    Point origin = r->origin;
+    Vector inverse(reciprocal(r->direction.x), reciprocal(r->direction.y), reciprocal(r->direction.z));
+    
+    // a box entered exactly at the closest distance may still hold an earlier object
+    if (enterBox(nodes[0].bounds, origin, inverse, closest ? closest->t : INFINITY) == INFINITY)
+        return;
+    
+    int stack[BVH_MAX_DEPTH];
+    int top = 0;
+    int node = 0;
+    while (true)
+    {
+        int a, b;
+        if (!children(node, a, b))
+        {
+            const Node &n = nodes[node];
+            for (int i = n.first; i < n.first + n.count; i++)
+                tryObject(s, order[i], r, closest, closestIndex);
+        }
+        else
+        {
+            // the nearer child first, since what it holds may rule out the other
+            float limit = closest ? closest->t : INFINITY;
+            float tA = enterBox(nodes[a].bounds, origin, inverse, limit);
+            float tB = enterBox(nodes[b].bounds, origin, inverse, limit);
+            if (tB < tA)
+            {
+                std::swap(a, b);
+                std::swap(tA, tB);
+            }
+            if (tA != INFINITY)
+            {
+                if (tB != INFINITY)
+                    stack[top++] = b;
+                node = a;
+                continue;
+            }
+        }
+        
+        // the next box on the stack the ray still enters before the closest hit
+        node = -1;
+        while (top > 0 && node < 0)
+        {
+            int next = stack[--top];
+            if (enterBox(nodes[next].bounds, origin, inverse, closest ? closest->t : INFINITY) != INFINITY)
+                node = next;
+        }
+        if (node < 0)
+            return;
+    }
+}
+
+#endif
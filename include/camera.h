@@ -0,0 +1,75 @@
+// This file defines the camera that makes the primary rays of an image.
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <scene.h>
+
+// rays Camera::makeRays makes at once
+#define RAY_BATCH 4
+
+/**
+ * Makes the rays from a scene's viewpoint through points on its view plane, turned the
+ * way the scene's viewRight and viewUp point. Points on the view plane are given in
+ * the camera's own coordinates, like the view plane extents.
+ *
+ * The left edge of every pixel column and the bottom edge of every row are worked out
+ * once, along with where the regular samples of each column and row lie, so finding
+ * a sample takes two lookups. The rays are made RAY_BATCH at a time with SSE where it
+ * is available, by a kernel compiled separately for orthographic and perspective
+ * views, which is picked once per camera instead of once per ray. Every ray comes
+ * out exactly as if it were computed on its own.
+ */
+class Camera
+{
+    public:
+        // for a width x height image with antialiasFactor regular samples across each pixel
+        Camera(Scene* s, int width, int height, bool orthographic, int antialiasFactor);
+        
+        // the size of a pixel on the view plane
+        float pixelWidth() { return pixWidth; }
+        float pixelHeight() { return pixHeight; }
+        
+        // the view plane coordinate of the left edge of pixel column x, and of the bottom
+        // edge of row y, counted from the bottom
+        float columnLeft(int x) { return columnLefts[x]; }
+        float rowBottom(int y) { return rowBottoms[y]; }
+        
+        // the view plane coordinate of regular sample j, from 1 to antialiasFactor, across
+        // column x, and of regular sample i up row y
+        float sampleX(int x, int j) { return sampleXs[(size_t) x * (k - 1) + j - 1]; }
+        float sampleY(int y, int i) { return sampleYs[(size_t) y * (k - 1) + i - 1]; }
+        
+        // loads the count rays through the view plane points (planeX[n], planeY[n]) into rays
+        void makeRays(const float* planeX, const float* planeY, int count, Ray* rays)
+        {
+            kernel(*this, planeX, planeY, count, rays);
+        }
+    
+    private:
+        Point viewpoint;
+        // the camera's axes in the scene: the view plane's x and y, the one it looks
+        // back along and the one it looks along
+        Vector right, up, back, forward;
+        float planeZ;
+        // the regular samples are k - 1 = antialiasFactor apart in each direction
+        int k;
+        float pixWidth, pixHeight;
+        vector<float> columnLefts, rowBottoms, sampleXs, sampleYs;
+        
+        void (*kernel)(const Camera &camera, const float* planeX, const float* planeY, int count, Ray* rays);
+        
+        template<bool Orthographic>
+        static void makeRaysKernel(const Camera &camera, const float* planeX, const float* planeY, int count,
+                                   Ray* rays);
+};
+
+// turns and moves the camera of a scene to look from eye at target, with up (roughly)
+// pointing up in the image
+void pointCamera(Scene* s, Point eye, Point target, Vector up);
+
+// sets the extents of a scene's view plane, at its distance from the viewpoint, to see
+// degrees from its bottom to its top edge, centered on the direction the camera
+// looks in and aspect (the image width over its height) times as wide as high
+void setFieldOfView(Scene* s, float degrees, float aspect);
+
+#endif
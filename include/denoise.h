@@ -0,0 +1,37 @@
+// This file defines post passes that clean up renders drawn with few rays per pixel.
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <trace.h>
+
+/**
+ * Filters colors (three floats per pixel, bottom row first, as drawSceneHDR stores them)
+ * in place with an edge-avoiding a-trous wavelet filter: passes of a 5x5 B-spline
+ * kernel whose taps are 1, 2, 4, ... pixels apart, so a few passes cover a wide area.
+ *
+ * The render outputs of the same render guide it. Pixels only blend with neighbours
+ * that hit the same object (objectId), at a similar depth and facing a similar way
+ * (normal), so edges between objects stay sharp while noise within surfaces is
+ * smoothed. Colors are also compared, ever more strictly in later passes. If albedo
+ * is given, colors are divided by it while filtering, so texture detail is kept. Any
+ * of the guides may be NULL.
+ *
+ * Rows are split over all cores and colors are handled as SSE vectors.
+ */
+void denoise(float* colors, int width, int height, const RenderOutputs &guides, int passes = 3);
+
+/**
+ * Finds the pixels on edges between surfaces, where a neighbour's guides show a
+ * different object, a different depth or a normal pointing elsewhere, and on shadow
+ * and texture edges, where a neighbour's color is far off, and draws them again with
+ * antialiasFactor. Edges are where a render with few rays per pixel looks
+ * worst (jaggies no filter can remove, since one ray can't tell how much of a pixel an
+ * object covers) and are usually a small fraction of the image, so a render at
+ * antialiasing factor 1 with its edges redrawn at 3 looks much like one drawn at 3
+ * everywhere, for a fraction of the rays. colors and guides are as for denoise.
+ * Returns the number of pixels redrawn.
+ */
+int redrawEdges(Scene* s, float* colors, int width, int height, const RenderOutputs &guides,
+                int maxDepth, bool orthographic, int antialiasFactor, SamplePattern pattern = REGULAR_SAMPLES);
+
+#endif
@@ -0,0 +1,44 @@
+// This file defines rendering a scene with several worker processes, possibly on
+// other machines, coordinated over sockets.
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <trace.h>
+
+// the parameters of a render, as sent from the coordinator to the workers
+struct DistributedSettings {
+    int width, height;
+    int maxDepth;
+    bool orthographic;
+    int antialiasFactor;
+    SamplePattern samplePattern;
+    PixelFilter pixelFilter;
+    // the image is split into tiles of tileSize x tileSize pixels
+    int tileSize;
+    // a tile that a worker has been working on for this many seconds is handed
+    // to the next idle worker as well; whichever result arrives first is used
+    double stallTimeout;
+};
+
+/**
+ * Listens on address (see net.h) and hands out the tiles of the image to whichever
+ * workers connect, assembling their results into buffer (8-bit rgb, top row first,
+ * like drawScene). localWorkers worker processes are forked to connect to it first;
+ * more can be started anywhere with runWorker. Workers that disconnect have their
+ * tile handed to someone else.
+ *
+ * Workers draw tiles with drawSceneTile, so the image is identical to drawScene's.
+ * Returns false if settings.tileSize isn't positive or the address can't be listened on.
+ */
+bool coordinateRender(const char* address, DistributedSettings settings, int localWorkers,
+                      SceneFactory createScene, unsigned char* buffer);
+
+/**
+ * Connects to the coordinator at address, builds the scene once, and draws the tiles
+ * the coordinator sends until it says the image is done. Every worker must build the
+ * same scene. Each tile is split over all cores. Returns false if the connection
+ * failed before the coordinator was done.
+ */
+bool runWorker(const char* address, SceneFactory createScene);
+
+#endif
@@ -0,0 +1,36 @@
+// This file defines float image files that are written through a memory mapping.
+#ifndef FLOATIMAGE_H
+#define FLOATIMAGE_H
+
+#include <cstddef>
+
+/**
+ * A float image that lives in a memory-mapped file, so that drawing into its pixels
+ * writes the file directly, with no encoding or copying afterwards.
+ *
+ * Files whose names end in .pfm get a PFM header (padded so the pixels stay 4-byte
+ * aligned); any other name gets just the raw native-endian floats. Either way the rows
+ * are stored from the bottom of the image up, which is the order drawSceneHDR uses.
+ */
+class MappedFloatImage
+{
+    public:
+        // width * height * channels floats, or NULL if no file is mapped
+        float* pixels;
+        
+        MappedFloatImage();
+        ~MappedFloatImage();
+        
+        // creates (or truncates) the file and maps it. channels must be 1 (grayscale)
+        // or 3 (rgb). returns false if the file could not be created or mapped.
+        bool create(const char* filename, int width, int height, int channels);
+        
+        // unmaps the file. the kernel writes any remaining dirty pages back to disk.
+        void close();
+        
+    private:
+        void* mapping;
+        size_t mappingSize;
+};
+
+#endif
@@ -0,0 +1,57 @@
+// This file defines a uniform grid over the objects of a scene.
+#ifndef GRID_H
+#define GRID_H
+
+#include <bvh.h>
+
+// cells a grid has for each object it holds, unless told otherwise
+#define GRID_DENSITY 2.0f
+// the most cells a grid has along any axis
+#define GRID_MAX_RESOLUTION 256
+// the objects a ray remembers having tried, so it doesn't try one again in the next
+// cell it shares (a power of two)
+#define GRID_MAILBOX_SIZE 64
+
+/**
+ * A box around the objects of a scene cut into equal cells, each listing the objects
+ * whose boxes overlap it. It is built in time linear in the number of objects, with
+ * about density cells to an object, shaped to the scene's box, so it suits many objects
+ * of about the same size spread through the scene, such as particles, and suits objects
+ * of very different sizes or bunched into a few places poorly. A ray walks the cells it
+ * passes through in order (3D-DDA), and stops after the first cell it leaves beyond its
+ * closest hit. An object in several cells is only tried once for a ray, as long as it
+ * is still in the ray's mailbox of recently tried objects.
+ *
+ * Planes and anything else without finite bounds are kept out of the grid and tried by
+ * every ray, and rays find exactly what trying every object in order would, as with a
+ * BVH. A grid must be built again after objects move.
+ */
+class Grid : public Accelerator
+{
+    public:
+        Grid(Scene* s, float density = GRID_DENSITY);
+        
+        virtual Intersection* findFirstIntersection(Ray* r);
+        
+        // the number of cells along axis (0, 1 or 2 for x, y or z)
+        int resolution(int axis) { return cells[axis]; }
+        // the bytes the grid takes
+        size_t memoryUsed();
+    
+    private:
+        Scene* scene;
+        Bounds bounds;
+        int cells[3];
+        float cellSize[3];
+        // the objects in cell i are the indices in scene->objects at cellObjects[cellStart[i]]
+        // up to cellObjects[cellStart[i + 1]], in order, with cells numbered x first
+        vector<int> cellStart;
+        vector<int> cellObjects;
+        vector<int> unbounded;
+        
+        void chooseResolution(int objects, float density);
+        // the cell along axis holding coordinate x, clamped to the grid
+        int cellOf(float x, int axis);
+};
+
+#endif
@@ -0,0 +1,106 @@
+// This file defines redrawing only the parts of an image that a scene edit affects.
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <trace.h>
+
+#include <unordered_set>
+
+// the kinds of rays a TraceRecorder keeps apart, since a box around rays going in
+// different directions covers far more space than a box around each direction
+enum RayKind {
+    PRIMARY_RAYS,
+    // reflected and refracted rays
+    SECONDARY_RAYS,
+    // shadow rays towards point light i are SHADOW_RAYS + i
+    SHADOW_RAYS
+};
+
+/**
+ * Collects what the rays traced for a rectangle of pixels depended on: the objects they
+ * hit, the point lights used to shade what they hit, and boxes around the ray segments,
+ * from where each ray starts to what it hit (or infinity). The boxes are kept per
+ * block of RECORD_BLOCK x RECORD_BLOCK pixels and per kind of ray, so they stay small.
+ *
+ * An edit that changes no object that was hit and no light that was used, and puts
+ * nothing into any of the boxes, can't change the color of any of the pixels.
+ */
+class TraceRecorder
+{
+    public:
+        // for a width x height rectangle of pixels, in a scene with numLights point lights
+        TraceRecorder(int width, int height, int numLights);
+        
+        // the pixel the rays recorded next belong to, counted from the bottom left of the rectangle
+        void setPixel(int x, int y);
+        
+        // a ray of a RayKind from origin to origin + t * direction. t may be infinite.
+        void recordSegment(int kind, Point origin, Vector direction, float t);
+        void recordHit(GeometricObject* object);
+        void recordLight(int light);
+        
+        // whether the colors could depend on object, where it is now, or on point light number light
+        bool dependsOn(GeometricObject* object);
+        bool dependsOnLight(int light);
+    
+    private:
+        int blocksAcross, kinds;
+        // the block setPixel picked
+        int block;
+        // kinds boxes for each block
+        vector<Bounds> segments;
+        std::unordered_set<GeometricObject*> objects;
+        vector<bool> lights;
+};
+
+/**
+ * Keeps an image of a scene up to date as the scene is edited, by redrawing only the
+ * tiles an edit can affect. Every tile keeps a TraceRecorder from when it was drawn
+ * last. After an edit, the tiles whose rays hit the edited object or pass where it is
+ * now, or that were shaded by an edited light, are marked, and update redraws just
+ * those into the image. The image is always exactly what drawScene would draw for the
+ * scene as it is.
+ */
+class IncrementalRenderer
+{
+    public:
+        // buffer holds the image, top row first like drawScene's, and stays the caller's
+        IncrementalRenderer(Scene* s, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic,
+                            int antialiasFactor, SamplePattern pattern = REGULAR_SAMPLES, int tileSize = 32);
+        
+        // draws every tile on all cores. needed first, and after changing anything but
+        // objects and point lights (the view plane, the background, ...)
+        void drawAll();
+        
+        // marks the tiles an edit of object could change. call it after the object was
+        // changed, moved or added to the scene, and before it is deleted.
+        void objectChanged(GeometricObject* object);
+        
+        // marks the tiles an edit of a point light could change. adding or removing a
+        // point light marks every tile.
+        void lightChanged(PointLight* light);
+        
+        // redraws the marked tiles on all cores and returns how many there were
+        int update();
+        
+        int tileCount() { return tilesAcross * tilesDown; }
+    
+    private:
+        Scene* scene;
+        unsigned char* buffer;
+        int width, height;
+        int maxDepth;
+        bool orthographic;
+        int antialias;
+        SamplePattern pattern;
+        int tileSize, tilesAcross, tilesDown;
+        // the number of point lights the recorders know of
+        int numLights;
+        
+        vector<TraceRecorder> recorders;
+        vector<bool> marked;
+        
+        void drawTile(int tile);
+};
+
+#endif
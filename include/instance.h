@@ -0,0 +1,54 @@
+// This file defines models that can be placed in a scene any number of times.
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <bvh.h>
+
+/**
+ * A group of objects, like the five rectangles of a table, kept once however many times
+ * it is placed in a scene with an Instance. The objects are given where the model's
+ * origin is, and a BVH over them is built when the model is made, so the objects must
+ * not move afterwards. The model owns them and deletes them with itself.
+ */
+class Model
+{
+    public:
+        Model(const vector<GeometricObject*> &objects);
+        ~Model();
+        
+        // the closest intersection of r with the objects, where the model's origin is
+        Intersection* intersect(Ray* r);
+        // the box around all of the objects
+        void getBounds(Point &min, Point &max);
+    
+    private:
+        // holds the objects and the BVH over them
+        Scene scene;
+        BVH* bvh;
+        Bounds bounds;
+};
+
+/**
+ * A model moved to offset. An instance takes no more memory than this, so a scene can
+ * hold many copies of a big model. Put in a scene's objects under a BVH, instances are
+ * found in a hierarchy of their own boxes, and the model's own hierarchy is only
+ * searched for the instances a ray gets to, so rays take time that grows with the
+ * logarithm of both the number of instances and the size of the model.
+ *
+ * What a ray hits in an instance has the instance as its object, with the normal and
+ * material of the object of the model that was hit.
+ */
+class Instance : public GeometricObject
+{
+    public:
+        Instance(Model* model, Vector offset);
+        virtual Intersection* intersect(Ray* r);
+        virtual void getBounds(Point &min, Point &max);
+        virtual void translate(Vector offset);
+    
+    private:
+        Model* model;
+        Vector offset;
+};
+
+#endif
@@ -0,0 +1,56 @@
+// This file defines a bounding volume hierarchy that is built as rays need it.
+#ifndef LAZYBVH_H
+#define LAZYBVH_H
+
+#include <bvh.h>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * A BVH that starts out as one box around every object, and splits a box into two
+ * only when a ray first gets into it, so drawing can start as soon as the boxes of the
+ * objects are known, and the parts of the scene no ray ever gets near are never
+ * sorted. The splits are the ones a BVH makes, so the finished parts of the tree, and
+ * what rays find, are the same as a BVH's.
+ *
+ * Rays can be traced from any number of threads at once. The first ray to get into a
+ * box splits it, and other rays that get there meanwhile wait for it to finish.
+ */
+class LazyBVH : public Accelerator
+{
+    public:
+        LazyBVH(Scene* s);
+        
+        virtual Intersection* findFirstIntersection(Ray* r);
+        
+        // how many boxes have been made so far
+        int nodesBuilt() { return nodeCount; }
+    
+    private:
+        enum NodeState { UNSPLIT, SPLITTING, LEAF, BRANCH };
+        
+        // a leaf holds the count objects from order[first], and a branch has its children
+        // at children and children + 1
+        struct Node {
+            Bounds bounds;
+            int first, count;
+            int children;
+            int depth;
+            std::atomic<int> state;
+        };
+        
+        Scene* scene;
+        // room for every node a tree over the objects can have, handed out in turn
+        std::unique_ptr<Node[]> nodes;
+        std::atomic<int> nodeCount;
+        vector<int> order;
+        vector<int> unbounded;
+        vector<Bounds> objectBounds;
+        
+        // makes node a leaf or a branch if it isn't yet, and returns which it is
+        int split(Node &node);
+        void initNode(Node &node, int first, int count, int depth);
+};
+
+#endif
@@ -792,6 +792,19 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Like lodepng_deflate, but doesn't end the deflate stream: no block is marked final, and the
+output is padded to a whole byte with an empty non-compressed block (like zlib's Z_SYNC_FLUSH).
+Outputs of consecutive calls can be concatenated, and compress independently of each other.
+The stream must be ended with a final block, e.g. the bytes 0x03 0x00 (an empty fixed block).
+*/
+unsigned lodepng_deflate_flush(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t insize,
+                               const LodePNGCompressSettings* settings);
+
+/*Update a running Adler-32 checksum (start with 1) of the zlib format with more data.*/
+unsigned lodepng_update_adler32(unsigned adler, const unsigned char* data, size_t len);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -0,0 +1,24 @@
+// This file defines small helpers for the socket connections between processes.
+#ifndef NET_H
+#define NET_H
+
+#include <cstddef>
+
+// Addresses are either "host:port" for TCP (an empty host or "*" listens on all
+// interfaces) or a path for a Unix domain socket, which must contain a '/' or
+// start with "unix:", e.g. "unix:raytrace.sock" or "/tmp/raytrace.sock".
+
+// creates a socket listening on address. returns the descriptor or -1 on failure.
+int listenOn(const char* address);
+
+// connects to address. returns the descriptor or -1 on failure.
+int connectTo(const char* address);
+
+// removes the socket file of a Unix domain address, if it is one
+void unlinkAddress(const char* address);
+
+// send or receive exactly length bytes. return false if the connection failed or closed.
+bool sendAll(int fd, const void* data, size_t length);
+bool recvAll(int fd, void* data, size_t length);
+
+#endif
@@ -0,0 +1,15 @@
+// This file defines helpers for spreading work over all cores.
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// the number of threads parallelFor uses, at least 1
+int threadCount();
+
+// calls body(i) for every i from begin to end - 1, spread over threadCount() threads.
+// iterations are handed out one at a time, so they should each do a fair amount of work.
+// returns once all of them are done.
+void parallelFor(int begin, int end, const std::function<void(int)> &body);
+
+#endif
@@ -0,0 +1,51 @@
+// This file defines a PNG writer that encodes an image a band of rows at a time.
+#ifndef PNGSTREAM_H
+#define PNGSTREAM_H
+
+#include <cstdio>
+#include <vector>
+
+using std::vector;
+
+/**
+ * Writes an 8-bit RGB PNG file incrementally, so that an image can be written
+ * while it is still being rendered and never has to be in memory all at once.
+ *
+ * Each band of rows passed to writeRows is filtered, deflated and appended to the
+ * file as its own IDAT chunk straight away. The deflate stream is flushed to a byte
+ * boundary after every band, so bands compress independently of each other and the
+ * only state kept between bands is the previous row (needed by the PNG filters) and
+ * the running Adler-32 checksum.
+ *
+ * All methods return 0 on success or a lodepng error code, which can be turned into
+ * a message with lodepng_error_text.
+ */
+class PNGStreamWriter
+{
+    public:
+        PNGStreamWriter();
+        ~PNGStreamWriter();
+        
+        // creates the file and writes the PNG header
+        unsigned open(const char* filename, unsigned width, unsigned height);
+        
+        // appends numRows rows of width * 3 bytes each, from the top of the image down
+        unsigned writeRows(const unsigned char* rows, unsigned numRows);
+        
+        // ends the image data and closes the file. all rows must have been written.
+        unsigned close();
+        
+    private:
+        FILE* file;
+        unsigned width, height;
+        unsigned rowsWritten;
+        unsigned adler;
+        
+        // the last row written, unfiltered, and scratch space for filtering
+        vector<unsigned char> previousRow;
+        vector<unsigned char> filtered;
+        
+        unsigned writeChunk(const char* type, const unsigned char* data, size_t length);
+};
+
+#endif
@@ -0,0 +1,35 @@
+// This file defines drawing previews that trace only some of the pixels.
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <trace.h>
+
+// which pixels drawScenePreview traces
+enum PreviewMode {
+    // every pixel, like drawScene
+    FULL_RESOLUTION,
+    // one pixel of every 2x2 block, a quarter of the image
+    HALF_RESOLUTION,
+    // every other pixel of each row, alternating like the squares of a checkerboard,
+    // half of the image. it costs more than HALF_RESOLUTION, but every missing pixel
+    // has four traced neighbours right next to it, so detail holds up better.
+    CHECKERBOARD
+};
+
+/**
+ * Draws a scene into buffer like drawScene, but only traces the pixels mode picks and
+ * fills in the rest from their traced neighbours.
+ *
+ * Boundaries stay as crisp as in a full render: a ray through the center of every
+ * missing pixel finds what it hits, without shading, so a missing pixel only takes
+ * colors from neighbours on the same object, weighted by how close their depth and
+ * normal are. A missing pixel with no such neighbour (an object too thin or small
+ * for the traced pixels to see) is traced itself.
+ *
+ * The pixels are spread over all cores. Returns the number of pixels that were traced,
+ * including the missing pixels that had to be.
+ */
+int drawScenePreview(Scene* s, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic,
+                     int antialiasFactor, PreviewMode mode, SamplePattern pattern = REGULAR_SAMPLES);
+
+#endif
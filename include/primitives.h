@@ -140,6 +140,11 @@ struct Texture
     Color operator()(float s, float t);
 };
 
+// makes a texture from 8-bit rgb pixels stored row by row from the top, like a decoded
+// png. the texture gets its own copy of the pixels, allocated with new[].
+Texture makeTexture(const unsigned char* rgb, int width, int height);
+
+// loads a png file as a texture. loading the same file again returns the same pixels.
 Texture loadTexture(const char* filename);
 
 #endif
\ No newline at end of file
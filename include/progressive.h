@@ -0,0 +1,98 @@
+// This file defines a renderer that refines the image in passes and can be stopped early.
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include <trace.h>
+
+#include <atomic>
+#include <functional>
+
+// called after every pass with the image so far (8-bit rgb, top row first, like
+// drawScene's buffer), the number of passes done and whether the image is complete
+typedef std::function<void(const unsigned char* image, int passesDone, bool complete)> PublishFunction;
+
+/**
+ * Draws a scene in passes of increasing quality, so that a usable image exists long
+ * before the full render is done.
+ *
+ * The first pass traces one ray per 4x4 block of pixels, the next one per 2x2 block
+ * and the next one per pixel. The remaining passes each add one more of the
+ * antialiasing samples to every pixel. Rays traced by earlier passes are reused, and
+ * samples are accumulated in the same order as in PixelSampler::drawPixel, so the
+ * image after the last pass is exactly what drawScene would have produced.
+ *
+ * The render stops early, publishing whatever it has, once the time budget runs out or
+ * stopProgressiveRender is called (which is safe to do from a signal handler).
+ */
+class ProgressiveRenderer
+{
+    public:
+        ProgressiveRenderer(Scene* s, int width, int height, int maxDepth, bool orthographic, int antialiasFactor,
+                            SamplePattern pattern = REGULAR_SAMPLES);
+        
+        // draws passes until the image is complete, timeBudget seconds have passed (if
+        // it is positive) or a stop is requested, calling publish after every pass and
+        // once more if stopped in the middle of one. returns whether the image is complete.
+        bool render(double timeBudget, PublishFunction publish);
+        
+        int passCount();
+        
+    private:
+        PixelSampler sampler;
+        int width, height;
+        
+        // sum of the samples traced so far and how many there are, per pixel,
+        // bottom row first like drawSceneHDR
+        vector<Color> sums;
+        vector<int> counts;
+        vector<unsigned char> image;
+        // set by whichever thread notices the time budget ran out
+        std::atomic<bool> outOfTime;
+        
+        // traces the first sample of the pixel at the corner of every block of
+        // blockSize x blockSize pixels that doesn't have one yet
+        void coarsePass(int blockSize, double deadline);
+        // adds sample number `sample` to every pixel
+        void refinePass(int sample, double deadline);
+        // fills image with the current estimate of every pixel
+        void updateImage();
+        bool shouldStop(double deadline);
+};
+
+// makes any running progressive render stop after the rows it is working on. renders
+// started afterwards aren't affected.
+void stopProgressiveRender();
+
+/**
+ * Publishes progressive renders into POSIX shared memory, so that other processes can
+ * watch the image improve. The memory holds a SharedImageHeader followed by the 8-bit
+ * rgb pixels, top row first.
+ */
+struct SharedImageHeader {
+    // 'RTPR'
+    unsigned magic;
+    unsigned width, height;
+    unsigned passesDone;
+    unsigned complete;
+    // odd while the image is being written. readers should copy the image and
+    // retry if the sequence was odd or changed in the meantime.
+    volatile unsigned sequence;
+};
+
+class SharedImagePublisher
+{
+    public:
+        SharedImagePublisher();
+        ~SharedImagePublisher();
+        
+        // creates (or reuses) the shared memory object with the given name, e.g. "/raytrace".
+        // returns false if it could not be created or mapped.
+        bool open(const char* name, int width, int height);
+        void publish(const unsigned char* image, int passesDone, bool complete);
+        
+    private:
+        SharedImageHeader* header;
+        size_t size;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * This file defines the C interface of libraytrace, for programs that want to draw
+ * scenes in-process instead of running the raytrace executable. Link with
+ * libraytrace.a or libraytrace.so (and -pthread and the C++ runtime).
+ *
+ * Coordinates and view plane conventions are the same as in scene.h: the viewpoint is
+ * at the origin looking down the negative z axis. Colors are three floats, usually
+ * between 0 and 1.
+ */
+#ifndef RAYTRACE_C_H
+#define RAYTRACE_C_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped whenever a function or struct in this file changes incompatibly */
+#define RT_API_VERSION 1
+
+/* return codes of rt_render */
+#define RT_OK               0
+#define RT_CANCELLED        1
+#define RT_INVALID_ARGUMENT 2
+
+/* axes for rt_scene_add_textured_rectangle */
+#define RT_XAXIS 0
+#define RT_YAXIS 1
+#define RT_ZAXIS 2
+
+typedef struct rt_scene rt_scene;
+
+typedef struct {
+    float ambient[3];
+    float diffuse[3];
+    float specular[3];
+    float refracted[3];
+    float emission[3];
+    float shininess;
+} rt_material;
+
+typedef struct {
+    int width, height;
+    /* the number of times rays are followed after reflection or refraction */
+    int max_depth;
+    /* nonzero for orthographic instead of perspective viewing */
+    int orthographic;
+    /* each pixel averages antialias^2 rays */
+    int antialias;
+} rt_render_settings;
+
+/* called after each row is drawn with the number of rows done so far */
+typedef void (*rt_progress_callback)(void* user_data, int rows_done, int rows_total);
+/* called before each row is drawn. returning nonzero stops the render. */
+typedef int (*rt_cancel_callback)(void* user_data);
+
+/* returns RT_API_VERSION of the library that is actually linked */
+int rt_api_version(void);
+
+/* an empty scene with a black background, no ambient light and a view plane
+   from -1 to 1 in both directions at z = -1 */
+rt_scene* rt_scene_create(void);
+/* frees the scene and everything that was added to it */
+void rt_scene_destroy(rt_scene* scene);
+
+void rt_scene_set_background(rt_scene* scene, const float color[3]);
+void rt_scene_set_ambient_light(rt_scene* scene, const float color[3]);
+/* the extents of the view plane, which is perpendicular to the z axis at z (negative) */
+void rt_scene_set_view_plane(rt_scene* scene, float top, float bottom, float left, float right, float z);
+
+void rt_scene_add_sphere(rt_scene* scene, const rt_material* material, const float center[3], float radius);
+void rt_scene_add_plane(rt_scene* scene, const rt_material* material, const float point[3], const float normal[3]);
+/* an axis-aligned rectangle spanning min to max, which must be equal on one axis */
+void rt_scene_add_rectangle(rt_scene* scene, const rt_material* material,
+                            const float min[3], const float max[3], const float normal[3]);
+/* like rt_scene_add_rectangle, with the texture's horizontal direction along s_axis
+   and its vertical direction along t_axis. pixels are 8-bit rgb, row by row from the
+   top, and are copied. */
+void rt_scene_add_textured_rectangle(rt_scene* scene, const rt_material* material,
+                                     const unsigned char* pixels, int texture_width, int texture_height,
+                                     int s_axis, int t_axis,
+                                     const float min[3], const float max[3], const float normal[3]);
+void rt_scene_add_point_light(rt_scene* scene, const float color[3], const float location[3]);
+void rt_scene_add_directional_light(rt_scene* scene, const float color[3], const float direction[3]);
+
+/*
+ * Draws the scene into buffer, which holds height rows of width 8-bit rgb pixels,
+ * starting with the top row, each row_stride bytes after the previous one (0 means
+ * width * 3). The rows are drawn on all cores, so the callbacks may be called from
+ * any of the rendering threads, but never more than one at a time. Either of them
+ * may be NULL. If the render is cancelled, rows that weren't drawn are left as they
+ * were. The pixels are exactly the ones the raytrace executable would produce.
+ *
+ * The scene must not be changed while it is being drawn, but it can be drawn by
+ * several threads at once.
+ */
+int rt_render(const rt_scene* scene, const rt_render_settings* settings,
+              unsigned char* buffer, size_t row_stride,
+              rt_progress_callback progress, rt_cancel_callback cancel, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
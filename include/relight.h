@@ -0,0 +1,65 @@
+// This file defines redrawing an image after only the point lights changed.
+#ifndef RELIGHT_H
+#define RELIGHT_H
+
+#include <trace.h>
+
+/**
+ * Keeps what every sample of an image hit first (where, the normal, the material and the
+ * direction it was seen from), and splits each pixel's color into the part no point
+ * light adds and one part per point light, computed as if the light were white.
+ *
+ * Drawing then just scales each light's part by its color and adds them up, without
+ * tracing anything, so changing the color of a light is free. Moving or adding a light
+ * only shades the kept hits again for that light: its shadow rays, and the reflected
+ * and refracted rays that carry its light, are traced again, while the parts of the
+ * other lights, with their own reflections and refractions, stay as they were.
+ *
+ * The image is what drawScene would draw, except that the parts are added in a
+ * different order, so a channel can be off by one now and then. Anything but the point
+ * lights changing needs drawAll. The kept hits take 128 bytes per sample, and
+ * each light another 12 bytes per pixel.
+ */
+class Relighter
+{
+    public:
+        Relighter(Scene* s, int width, int height, int maxDepth, bool orthographic, int antialiasFactor,
+                  SamplePattern pattern = REGULAR_SAMPLES);
+        
+        // finds and shades the hits of every sample on all cores. needed first.
+        void drawAll();
+        
+        // shades the kept hits again for light, after it moved or was added to the
+        // scene. changing only its color needs nothing.
+        void lightChanged(PointLight* light);
+        
+        // forgets the part of the light that was number index, after it was taken out
+        // of the scene
+        void lightRemoved(int index);
+        
+        // loads the image into buffer, top row first like drawScene's
+        void draw(unsigned char* buffer);
+    
+    private:
+        Scene* scene;
+        int width, height;
+        int maxDepth;
+        bool orthographic;
+        int antialias;
+        SamplePattern pattern;
+        // samples per pixel
+        int d;
+        
+        // per sample, bottom row first, the samples of a pixel next to each other
+        vector<Ray> rays;
+        vector<PrimaryHit> hits;
+        // three floats per pixel, bottom row first, averaged over the samples: the part
+        // no point light adds, and the part of each light
+        vector<float> unlit;
+        vector<vector<float> > lit;
+        
+        // loads the average of the lights part of every pixel into colors
+        void shadeAll(int lights, vector<float> &colors);
+};
+
+#endif
@@ -0,0 +1,81 @@
+// This file defines a pool of threads that draws several scenes at once in the background.
+#ifndef RENDERPOOL_H
+#define RENDERPOOL_H
+
+#include <trace.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class RenderPool;
+
+// the state a render job shares between its handle and the pool's threads
+struct RenderJobState;
+
+/**
+ * A handle to a render submitted to a RenderPool. Copies refer to the same render.
+ * None of the functions block except wait.
+ */
+class RenderJob
+{
+    public:
+        // the number of tiles drawn so far and in total
+        int tilesDone();
+        int tileCount();
+        
+        // asks the job to stop. tiles that are being drawn are finished, no new ones
+        // are started, and the job then counts as done without being complete.
+        void cancel();
+        
+        // whether the job has finished, either complete or cancelled
+        bool done();
+        // blocks until the job is done. returns whether the whole image was drawn.
+        bool wait();
+        
+        // runs continuation(complete) once the job is done: right away on this thread if
+        // it already is, or else on the pool thread that finished it. continuations
+        // should be short, e.g. hand the image to another thread or queue; they must not
+        // wait for jobs of the same pool.
+        void then(std::function<void(bool complete)> continuation);
+        
+    private:
+        friend class RenderPool;
+        std::shared_ptr<RenderJobState> state;
+};
+
+/**
+ * Draws scenes tile by tile on its own threads, so the thread that submits a render
+ * never has to block on it. When several jobs are running, the threads take tiles from
+ * them in turn, so a small job submitted while a huge one is running still finishes
+ * quickly. Tiles are drawn with drawSceneTile, so images are identical to drawScene's.
+ */
+class RenderPool
+{
+    public:
+        // starts threads threads, or one per core if it is 0
+        RenderPool(int threads = 0);
+        // cancels all jobs that are still running and waits for the threads to finish
+        ~RenderPool();
+        
+        // starts drawing a scene into buffer, which has the same layout as drawScene's.
+        // the scene and buffer must stay valid until the job is done.
+        RenderJob submit(Scene* s, unsigned char* buffer, int width, int height, int maxDepth,
+                         bool orthographic, int antialiasFactor, int tileSize = 64,
+                         SamplePattern pattern = REGULAR_SAMPLES);
+        
+    private:
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        // jobs that still have tiles nobody has started, in the order they get their next tile
+        std::deque<std::shared_ptr<RenderJobState> > queue;
+        bool stopping;
+        
+        void work();
+};
+
+#endif
@@ -0,0 +1,83 @@
+// This file defines drawing camera animations that reuse the pixels of the previous frame.
+#ifndef REPROJECT_H
+#define REPROJECT_H
+
+#include <trace.h>
+
+// what drawing a frame reused from the one before
+struct ReuseStats {
+    // the pixels whose color came from the previous frame
+    int pixelsReused;
+    // the rays from the camera the frame took, including the one testing each pixel,
+    // and the ones drawScene would have taken
+    long raysTraced, fullFrameRays;
+    
+    // the part of drawScene's rays from the camera the frame saved
+    float raysSaved() const { return 1 - (float) raysTraced / fullFrameRays; }
+};
+
+/**
+ * Draws the frames of an animation in which only the camera of the scene moves or
+ * turns, reusing what it can of the frame before.
+ *
+ * Every frame finds what the ray closest to the center of each pixel hits first,
+ * without shading it. A pixel whose hit lands, in the previous frame, on a pixel that
+ * showed the same object, facing about the same way, with its color shaded at a point
+ * at most REPROJECT_TOLERANCE pixels from the new hit, takes that color. Everything
+ * else is traced, shading that hit rather than tracing its ray again: pixels that were
+ * hidden or outside the image before, reflective and refractive surfaces (their colors
+ * depend on where they are seen from), and the edges of objects, shadows and texture
+ * details, where a slight shift changes the color a lot. A reused color keeps the point
+ * it was shaded at, so frame after frame it drifts until it is too far and gets traced
+ * again; errors don't pile up. The frames are close to what drawScene draws, not exact:
+ * a reused color is off by as much as the color changes over a fraction of a pixel.
+ *
+ * Nothing but the viewpoint and the camera's axes may change between frames; after
+ * any other edit of the scene, call reset so the next frame is traced in full.
+ */
+class TemporalRenderer
+{
+    public:
+        TemporalRenderer(Scene* s, int width, int height, int maxDepth, bool orthographic, int antialiasFactor,
+                         SamplePattern pattern = REGULAR_SAMPLES);
+        
+        // draws the scene as its camera sees it now into buffer, top row first like
+        // drawScene's, on all cores, and returns what reusing the previous frame saved
+        ReuseStats drawFrame(unsigned char* buffer);
+        
+        // forgets the previous frame
+        void reset() { hasPrevious = false; }
+    
+    private:
+        Scene* scene;
+        int width, height;
+        int maxDepth;
+        bool orthographic;
+        int antialias;
+        SamplePattern pattern;
+        
+        // what each pixel of a frame holds, bottom row first
+        struct PixelRecord {
+            Color color;
+            // what the ray through the center hit, or NULL
+            GeometricObject* object;
+            Vector normal;
+            // where the color was shaded, which for a reused color is where it was
+            // shaded in an earlier frame
+            Point shadedAt;
+            // whether a later frame may take the color
+            bool reusable;
+        };
+        vector<PixelRecord> current, previous;
+        bool hasPrevious;
+        // the camera of the previous frame
+        Point previousViewpoint;
+        Vector previousRight, previousUp;
+        
+        // the pixel of the previous frame that showed point, or -1 if it was outside
+        int previousPixel(Point point);
+        // the width of a pixel where point is seen from the current viewpoint
+        float footprint(Point point);
+};
+
+#endif
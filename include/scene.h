@@ -14,6 +14,19 @@ using std::vector;
 struct PointLight;
 struct DirectionalLight;
 
+// an axis-aligned box
+struct Bounds {
+    Point min, max;
+    
+    // an empty box
+    Bounds();
+    Bounds(Point min, Point max);
+    
+    // grows the box to contain b
+    void add(const Bounds &b);
+    bool overlaps(const Bounds &b) const;
+};
+
 class GeometricObject 
 {
     public:
@@ -28,16 +41,47 @@ class GeometricObject
          * Intersections at or approximately at the ray's origin should not be considered.
          */
         virtual Intersection* intersect(Ray* r) = 0;
+        
+        /**
+         * Loads the corners of an axis-aligned box that contains the whole object into
+         * min and max. Coordinates are infinite in the directions an object is unbounded.
+         */
+        virtual void getBounds(Point &min, Point &max) = 0;
+        
+        // moves the object by offset
+        virtual void translate(Vector offset) = 0;
+        
+        virtual ~GeometricObject() {}
+};
+
+/**
+ * Finds the first object a ray hits without trying every object of a scene, like a
+ * bounding volume hierarchy (see bvh.h). It must find exactly what trying the objects
+ * in order would: the closest intersection, and of equally close ones the one with the
+ * object that comes first in Scene::objects.
+ */
+class Accelerator
+{
+    public:
+        // the closest intersection, or NULL if there is none. the caller deletes it.
+        virtual Intersection* findFirstIntersection(Ray* r) = 0;
+        
+        virtual ~Accelerator() {}
 };
 
 struct Scene {
     Color backgroundColor;
     Color ambientLight;
     
-    // The viewpoint of the scene is always at the origin facing
-    // in the negative-z direction, so the viewplane is always
-    // perpendicular to the z-axis and should have a negative z
-    // value. These parameters specify the extents of the view plane.
+    // The view plane is perpendicular to the z-axis of the camera
+    // and should have a negative z value, so the viewpoint faces in
+    // the negative-z direction. These parameters specify the extents
+    // of the view plane relative to the viewpoint, which is at the
+    // origin unless it is moved. viewRight and viewUp are the camera's
+    // x and y axes in the scene, (1,0,0) and (0,1,0) unless the camera
+    // is turned, and must be perpendicular unit vectors (see camera.h).
+    Point viewpoint;
+    Vector viewRight, viewUp;
     float viewPlaneTop;
     float viewPlaneBottom;
     float viewPlaneLeft;
@@ -47,8 +91,19 @@ struct Scene {
     vector<GeometricObject*> objects;
     vector<PointLight*> pointLights;
     vector<DirectionalLight*> directionalLights;
+    
+    // when set, rays are intersected with the objects through this instead of with each
+    // object in turn. it must be brought up to date after objects move. copies of a scene
+    // share it.
+    Accelerator* accelerator;
+    
+    // a scene with an unturned camera at the origin and no accelerator
+    Scene();
 };
 
+// a function that builds a complete scene, like createScene in raytrace.cpp
+typedef Scene* (*SceneFactory)();
+
 /*************************************************
  ****************** OBJECT TYPES *****************
  *************************************************/
@@ -66,6 +121,8 @@ class Sphere : public GeometricObject
         
         Sphere(Material m, Point center, float radius);
         virtual Intersection* intersect(Ray* r);
+        virtual void getBounds(Point &min, Point &max);
+        virtual void translate(Vector offset);
 };
 
 class Plane : public GeometricObject
@@ -80,6 +137,8 @@ class Plane : public GeometricObject
     public:
         Plane(Material m, Point point, Vector normal);
         virtual Intersection* intersect(Ray* r);
+        virtual void getBounds(Point &min, Point &max);
+        virtual void translate(Vector offset);
 };
 
 class Rectangle : public GeometricObject
@@ -98,6 +157,8 @@ class Rectangle : public GeometricObject
         Rectangle(Material m, 
             float xMax, float xMin, float yMax, float yMin, float zMax, float zMin, Vector normal);
         virtual Intersection* intersect(Ray* r);
+        virtual void getBounds(Point &min, Point &max);
+        virtual void translate(Vector offset);
 };
 
 #define XAXIS 0
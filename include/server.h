@@ -0,0 +1,50 @@
+// This file defines a long-running render server that keeps scenes loaded between requests.
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <trace.h>
+#include <preview.h>
+
+// a scene clients can ask for by name
+struct NamedScene {
+    const char* name;
+    SceneFactory create;
+};
+
+// what a request draws when it doesn't say otherwise
+struct RenderDefaults {
+    int width, height;
+    int maxDepth;
+    bool orthographic;
+    int antialiasFactor;
+    SamplePattern samplePattern;
+    PreviewMode previewMode;
+};
+
+/**
+ * Listens on address and draws images for every client that connects, each on its
+ * own thread, until the process is killed. Each image is drawn on all cores. Every
+ * scene is built the first time it is asked for and then kept, and textures are only
+ * ever decoded once, so a request only pays for tracing and encoding.
+ *
+ * A request is one line of space separated key=value pairs:
+ *
+ *   scene=<name> width=<pixels> height=<pixels> aa=<factor> depth=<recursion depth>
+ *   ortho=<0|1> top=<y> bottom=<y> left=<x> right=<x> z=<view plane z> output=<path>
+ *   pattern=<regular|jittered|rotated|halton|sobol> preview=<full|half|checkerboard>
+ *
+ * All of them are optional; scene defaults to the first of scenes, the view plane to
+ * the scene's and the rest to defaults. Since any client can connect to a TCP address,
+ * output is only allowed under outputDirectory, or relative to the working directory
+ * when there is none and address is a Unix domain socket, and it must be a relative
+ * path without "..". The answer is "OK <path>" if output was given
+ * and the image was written there, or "PNG <length>" followed by that many bytes of
+ * PNG file, or "ERROR <reason>", each on a line of its own. A connection can send any
+ * number of requests, one after the other.
+ *
+ * Returns false if the address can't be listened on.
+ */
+bool runRenderServer(const char* address, const NamedScene* scenes, int numScenes, RenderDefaults defaults,
+                     const char* outputDirectory = NULL);
+
+#endif
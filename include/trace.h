@@ -4,13 +4,227 @@
 #include <primitives.h>
 #include <intersection.h>
 #include <scene.h>
+#include <camera.h>
+
+class TraceRecorder;
+
+// where the antialiasFactor^2 rays of a pixel pass through it
+enum SamplePattern {
+    // an evenly spaced grid, the same in every pixel
+    REGULAR_SAMPLES,
+    // one random point in each cell of an antialiasFactor x antialiasFactor grid
+    JITTERED_SAMPLES,
+    // the centers of those cells, rotated by atan(1/2) and wrapped around the pixel,
+    // so edges close to horizontal or vertical are crossed at more distinct offsets
+    ROTATED_GRID_SAMPLES,
+    // the first points of the Halton sequence in bases 2 and 3
+    HALTON_SAMPLES,
+    // the first points of the 2D Sobol sequence, which are stratified in every
+    // direction when antialiasFactor is a power of two
+    SOBOL_SAMPLES
+};
+
+/**
+ * How the samples of a pixel are combined. With BOX_FILTER every pixel averages its
+ * own antialiasFactor^2 samples in a SamplePattern. The other filters instead take
+ * samples on a lattice antialiasFactor samples per pixel apart that includes the
+ * pixel corners and edges, so each sample is traced once and shared by all the
+ * pixels whose filter covers it. A pixel is the weighted average of the samples
+ * around its center. That costs about antialiasFactor^2 rays per pixel, like the box
+ * filter, but each pixel uses several times as many samples. Tiles and bands trace the
+ * lattice points they need themselves, so they join without seams.
+ */
+enum PixelFilter {
+    BOX_FILTER,
+    // weights fall linearly to 0 one pixel from the center
+    TENT_FILTER,
+    // the Mitchell-Netravali filter with B = C = 1/3, two pixels wide on each side,
+    // which is sharper than the tent filter
+    MITCHELL_FILTER
+};
+
+// rows of pixels drawn from one block of lattice samples, which bounds the memory the
+// samples take. blocks overlap by the filter radius, so smaller blocks trace more twice,
+// and so does every separate call drawing a few rows with a filter.
+#define FILTER_BAND_HEIGHT 32
 
 // draws a scene and loads the resulting pixels into buffer
-void drawScene(Scene* s, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic, int antialiasFactor);
+void drawScene(Scene* s, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic, int antialiasFactor,
+               SamplePattern pattern = REGULAR_SAMPLES, PixelFilter filter = BOX_FILTER);
+
+// draws only the image rows firstRow to firstRow + numRows - 1, counted from the top of
+// the image, into buffer, which holds just those rows. the pixels are exactly the ones
+// drawScene would produce for the same rows.
+void drawSceneRows(Scene* s, unsigned char* buffer, int width, int height, int firstRow, int numRows,
+                   int maxDepth, bool orthographic, int antialiasFactor, SamplePattern pattern = REGULAR_SAMPLES,
+                   PixelFilter filter = BOX_FILTER);
+
+// draws only the tileWidth x tileHeight pixels whose top left corner is column left
+// of image row top into buffer, which holds just those pixels, row by row from the top.
+void drawSceneTile(Scene* s, unsigned char* buffer, int width, int height,
+                   int left, int top, int tileWidth, int tileHeight,
+                   int maxDepth, bool orthographic, int antialiasFactor, SamplePattern pattern = REGULAR_SAMPLES,
+                   PixelFilter filter = BOX_FILTER);
+
+// a rectangle of pixels, as drawSceneTile takes them: width x height pixels whose top
+// left corner is column left of image row top
+struct CropWindow {
+    int left, top;
+    int width, height;
+};
+
+// the smallest window of pixels that covers the part of the view plane from left to
+// right and bottom to top (in view plane coordinates), clipped to the image. its width
+// or height is 0 if that part is outside the view plane.
+CropWindow cropToViewPlane(Scene* s, int width, int height, float left, float right, float bottom, float top);
+
+// what the first ray of a pixel hit, for the extra render outputs
+struct PrimaryHit {
+    // the object hit, or NULL if the ray hit nothing
+    GeometricObject* object;
+    // the ray parameter at the hit, i.e. the distance from the view plane
+    float t;
+    // where the ray hit, on the object
+    Point point;
+    Vector normal;
+    Material material;
+};
+
+// extra per-pixel outputs that drawSceneHDR can fill in the same pass as the colors,
+// from what the ray closest to the center of each pixel hit first. any of them may
+// be NULL. they are stored bottom row first like the colors.
+struct RenderOutputs {
+    // one float per pixel: the distance from the view plane, infinity where nothing was hit
+    float* depth;
+    // three floats per pixel: the surface normal, 0 where nothing was hit
+    float* normal;
+    // one float per pixel: the index of the object in Scene::objects plus one, 0 where nothing was hit
+    float* objectId;
+    // three floats per pixel: the diffuse color of the material, 0 where nothing was hit
+    float* albedo;
+};
+
+// draws a scene and loads the unclamped color of every pixel into buffer as three floats.
+// rows are stored from the bottom of the image up, as in PFM files, which is the
+// order the view plane is traversed in. outputs may be NULL. with a filter other than
+// BOX_FILTER, the outputs come from where a ray through each pixel center first hits,
+// which is found without shading it.
+void drawSceneHDR(Scene* s, float* buffer, int width, int height, int maxDepth, bool orthographic, int antialiasFactor,
+                  RenderOutputs* outputs, SamplePattern pattern = REGULAR_SAMPLES, PixelFilter filter = BOX_FILTER);
+
+// converts a buffer filled by drawSceneHDR into the 8-bit buffer drawScene would have
+// produced, using all cores
+void quantizeHDR(const float* hdr, unsigned char* buffer, int width, int height);
+
+// converts a color to the 8-bit rgb values drawScene stores for it in the png
+inline void quantizePixel(Color c, unsigned char* out)
+{
+    c.clampThis();
+    out[0] = (unsigned char) (c.r * 255);
+    out[1] = (unsigned char) (c.g * 255);
+    out[2] = (unsigned char) (c.b * 255);
+}
+
+/**
+ * Computes the colors of individual pixels, averaging antialiasFactor^2 rays spread
+ * over each pixel in a SamplePattern. All of the draw functions use this, so a pixel
+ * gets exactly the same color no matter which of them drew it.
+ *
+ * The random parts of the patterns (the jitter, and a Cranley-Patterson rotation of the
+ * Halton and Sobol points that decorrelates neighbouring pixels) are seeded by the
+ * pixel's position, so they are the same in every render.
+ *
+ * If recorder isn't NULL, every ray the sampler traces is reported to it. The camera
+ * is taken from the scene when the sampler is made, so moving it afterwards needs a
+ * new sampler.
+ */
+class PixelSampler
+{
+    public:
+        PixelSampler(Scene* s, int width, int height, int maxDepth, bool orthographic, int antialiasFactor,
+                     SamplePattern pattern = REGULAR_SAMPLES, TraceRecorder* recorder = NULL);
+        
+        // loads the unclamped color of the pixel in column x into c. y counts
+        // rows up from the bottom of the view plane, so it is the image row height - y - 1.
+        // if hit isn't NULL, it gets what the ray closest to the pixel center hit.
+        void drawPixel(int x, int y, Color &c, PrimaryHit* hit = NULL);
+        
+        // loads the colors of the count pixels from column x of row y into colors, as
+        // drawPixel would, making the rays of neighbouring pixels together. hits, if
+        // not NULL, gets count hits.
+        void drawPixels(int x, int y, int count, Color* colors, PrimaryHit* hits = NULL);
+        
+        // loads the color of a single one of the samples drawPixel averages into c.
+        // adding samples 0 to samplesPerPixel() - 1 in order and dividing by
+        // samplesPerPixel() gives exactly the color drawPixel computes.
+        void drawSample(int x, int y, int sample, Color &c);
+        int samplesPerPixel() { return d; }
+        
+        // loads the color of the ray through the point x pixels from the left and y pixels
+        // from the bottom of the view plane into c, for samples that aren't in a pattern.
+        // if hit isn't NULL, it gets what the ray hit.
+        void drawAt(float x, float y, Color &c, PrimaryHit* hit = NULL);
+        // loads what the ray drawAt would trace for the same point hits first into hit,
+        // without shading it
+        void findHitAt(float x, float y, PrimaryHit &hit);
+        
+        // loads what the ray through the center of the pixel hits first into hit,
+        // without shading it, which costs a fraction of a traced ray. the material is
+        // left out.
+        void findPrimaryHit(int x, int y, PrimaryHit &hit);
+        
+        // loads what the ray drawPixel reports the hit of, the one closest to the pixel
+        // center, hits first into hit, without shading it
+        void findCenterHit(int x, int y, PrimaryHit &hit);
+        // loads the color drawPixel would compute for the pixel into c, given what
+        // findCenterHit found for it, which saves tracing that ray again. the recorder
+        // doesn't hear about the rays that shading the center hit traces.
+        void shadePixel(int x, int y, const PrimaryHit &centerHit, Color &c);
+        
+        // loads the ray of a single one of the samples drawPixel averages into r
+        void primaryRay(int x, int y, int sample, Ray &r);
+    
+    private:
+        Scene* scene;
+        TraceRecorder* recorder;
+        int maxDepth;
+        SamplePattern pattern;
+        // the regular samples are k - 1 = antialiasFactor apart in each direction, d in total
+        int k, d;
+        Camera camera;
+        
+        // where a sample of a pixel lies on the view plane
+        void samplePoint(int x, int y, int sample, float &planeX, float &planeY);
+        // where a sample of any pattern but the regular one lies in the pixel, from 0 to 1
+        // in each direction
+        void sampleOffset(int x, int y, int sample, float &u, float &v);
+        // the sample closest to the center of the pixel
+        int centerSample(int x, int y);
+};
 
 // traces a ray and loads the resulting color into c.
 // assumes that the direction vector of r is normalized.
-void trace(Scene* s, Ray* r, int maxDepth, Color &c);
+// if hit isn't NULL, it gets what the ray itself hit.
+// if recorder isn't NULL, it gets r and every reflected, refracted and shadow ray
+// traced on its behalf (see incremental.h).
+void trace(Scene* s, Ray* r, int maxDepth, Color &c, PrimaryHit* hit = NULL, TraceRecorder* recorder = NULL);
+
+// the parts of a traced color shade can compute on their own: a point light number
+// from 0 up, or one of these
+#define ALL_LIGHTS -2
+// everything that doesn't depend on the point lights: ambient light, emission, the
+// background and directional lights seen directly
+#define NO_LIGHTS -1
+
+// loads what r hits first into hit, as trace would, without shading it
+void findFirstHit(Scene* s, Ray* r, PrimaryHit &hit);
+
+// loads the color trace would compute for r into c, given what r hit, which saves
+// finding it again. with lights set to a point light's number, c is only what that
+// light adds to the color, including through reflections, refractions and shadows,
+// as if it were white, so it only needs to be multiplied by the light's color. the
+// colors for NO_LIGHTS and each of the point lights add up to the whole color.
+void shade(Scene* s, Ray* r, const PrimaryHit &hit, int maxDepth, Color &c, int lights = ALL_LIGHTS);
 
 // finds the object closest to the origin of the ray which the ray intersects
 Intersection* findFirstIntersection(Scene* s, Ray* r);
@@ -0,0 +1,14 @@
+// This file defines small helpers the drawing functions share.
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <string>
+
+// the wall clock time in seconds, for timing how long something takes
+double now();
+
+// outputFile with suffix put before its extension, for the files of a series of images
+// drawn for one output file: "raytrace.png" and "0001" give "raytrace0001.png"
+std::string numberedFileName(const char* outputFile, const std::string &suffix);
+
+#endif
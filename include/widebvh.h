@@ -0,0 +1,71 @@
+// This file defines bounding volume hierarchies with four or eight children to a node.
+#ifndef WIDEBVH_H
+#define WIDEBVH_H
+
+#include <bvh.h>
+
+#include <cstdint>
+
+/**
+ * A BVH with Width (4 or 8) children to a node, made by folding the levels of a binary
+ * BVH together, so a ray tests all the children of a node at once: four with SSE, and
+ * eight with AVX2 where the processor has it (plain floats elsewhere). The boxes of
+ * the children are kept as bytes across their parent's box, rounded outwards so they
+ * still hold everything they did, so a four-wide node fits in a 64-byte cache line.
+ * A ray takes the side of each box it enters from the signs of its direction, and
+ * visits the children it enters nearest first.
+ *
+ * Rays find what they would with a BVH. A wide BVH can't be refitted: make a new one
+ * after objects move.
+ */
+template<int Width>
+class WideBVH : public Accelerator
+{
+    public:
+        WideBVH(Scene* s);
+        
+        virtual Intersection* findFirstIntersection(Ray* r);
+        
+        // the bytes the tree takes
+        size_t memoryUsed();
+    
+    private:
+        struct Node {
+            // the node's box, from origin to origin + 255 * scale along each axis
+            float origin[3], scale[3];
+            // the boxes of the children, from origin + low * scale to origin + high * scale
+            uint8_t low[3][Width], high[3][Width];
+            // the node a child is, ~i for leaf i, or EMPTY_CHILD where there is no child
+            int32_t child[Width];
+        };
+        
+        // the count objects from order[first]
+        struct Leaf {
+            int first, count;
+        };
+        
+        Scene* scene;
+        vector<Node> nodes;
+        vector<Leaf> leaves;
+        vector<int> order;
+        vector<int> unbounded;
+        
+        // makes the node for the children of binary branch node and those below
+        int collapse(const BVH &binary, int node);
+        // makes the node for binary node with the given binary nodes as its children
+        int makeNode(const BVH &binary, int node, const vector<int> &children);
+        // a child of a node for binary node
+        int32_t addChild(const BVH &binary, int node);
+        
+        // loads the distance along a ray where it enters each child of node into t, or
+        // INFINITY where it misses it or enters it after limit. origin and inverse are the
+        // ray's origin and the reciprocals of its direction, and near[axis] is 1 where the
+        // near side of a box is its high one.
+        static void enterChildren(const Node &node, const float* origin, const float* inverse, const int* near,
+                                  float limit, float* t);
+};
+
+typedef WideBVH<4> BVH4;
+typedef WideBVH<8> BVH8;
+
+#endif
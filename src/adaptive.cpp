@@ -0,0 +1,206 @@
+#include <adaptive.h>
+#include <parallel.h>
+#include <util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+
+struct QualityLevel {
+    int antialias;
+    int depth;
+    // measured so far at this level
+    double seconds;
+    double pixels;
+};
+
+/**
+ * Picks quality levels for tiles from how long earlier tiles took. Shared by all the
+ * drawing threads.
+ */
+class QualityController
+{
+    public:
+        QualityController(int maxDepth, int antialiasFactor, int tileCount, int threads, double deadline)
+        {
+            for (int depth = 1; depth < maxDepth; depth++)
+                addLevel(1, depth);
+            for (int aa = 1; aa <= antialiasFactor; aa++)
+                addLevel(aa, std::max(maxDepth, 1));
+            
+            tilesLeft = tileCount;
+            upgradeCredit = 0;
+            this->threads = threads;
+            this->deadline = deadline;
+        }
+        
+        // picks the level of the next tile to be drawn
+        int startTile(int pixels)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            double share = (deadline - now()) * threads / tilesLeft--;
+            
+            // the cheapest level if out of time
+            int best = 0;
+            for (int i = (int) levels.size() - 1; i > 0 && share > 0; i--)
+            {
+                if (predictSeconds(i) * pixels <= share)
+                {
+                    best = i;
+                    break;
+                }
+            }
+            if (best == (int) levels.size() - 1 || share <= 0)
+                return best;
+            
+            // the share usually falls between two levels. draw the right fraction of
+            // tiles at the better one, spread out like error diffusion, so the time
+            // left over isn't all spent at the end.
+            double lower = predictSeconds(best) * pixels;
+            double upper = predictSeconds(best + 1) * pixels;
+            if (upper > lower)
+                upgradeCredit += std::max(0.0, share - lower) / (upper - lower);
+            if (upgradeCredit >= 1)
+            {
+                upgradeCredit -= 1;
+                best++;
+            }
+            return best;
+        }
+        
+        void finishTile(int level, int pixels, double seconds)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            levels[level].seconds += seconds;
+            levels[level].pixels += pixels;
+        }
+        
+        const QualityLevel &level(int i) { return levels[i]; }
+        int topLevel() { return levels.size() - 1; }
+    
+    private:
+        vector<QualityLevel> levels;
+        int tilesLeft;
+        double upgradeCredit;
+        int threads;
+        double deadline;
+        std::mutex mutex;
+        
+        void addLevel(int antialias, int depth)
+        {
+            QualityLevel level = {antialias, depth, 0, 0};
+            levels.push_back(level);
+        }
+        
+        // the expected time per pixel at level i, once any level has been measured. levels that haven't
+        // been measured are scaled from the nearest one that has by the number of rays
+        // per pixel. how much depth costs depends on the scene, so it is only known once
+        // a level is used.
+        double predictSeconds(int i)
+        {
+            if (levels[i].pixels > 0)
+                return levels[i].seconds / levels[i].pixels;
+            
+            int nearest = -1;
+            for (int j = 0; j < (int) levels.size(); j++)
+                if (levels[j].pixels > 0 && (nearest < 0 || abs(j - i) < abs(nearest - i)))
+                    nearest = j;
+            
+            const QualityLevel &from = levels[nearest];
+            double perPixel = from.seconds / from.pixels;
+            double rays = (double) levels[i].antialias * levels[i].antialias / (from.antialias * from.antialias);
+            return perPixel * rays;
+        }
+};
+
+QualityReport drawSceneWithDeadline(Scene* scene, unsigned char* buffer, int width, int height, int maxDepth,
+                                    bool orthographic, int antialias, double timeBudget, int tileSize,
+                                    SamplePattern pattern)
+{
+    double start = now();
+    
+    QualityReport report;
+    report.seconds = report.averageSamples = 0;
+    report.tileCount = report.fullQualityTiles = 0;
+    report.minAntialias = report.maxAntialias = report.minDepth = report.maxDepth = 0;
+    // nothing to draw, or no way to split it into tiles
+    if (tileSize <= 0 || width <= 0 || height <= 0)
+        return report;
+    
+    int tilesAcross = (width + tileSize - 1) / tileSize;
+    int tilesDown = (height + tileSize - 1) / tileSize;
+    int tileCount = tilesAcross * tilesDown;
+    
+    // visit tile (i * step) % tileCount i-th, with step coprime to the count and near
+    // the golden ratio of it, so that the tiles drawn so far are always spread over the
+    // image and the cost estimates aren't skewed by one expensive region
+    int step = std::max(1, (int) (tileCount * 0.618));
+    while (std::gcd(step, tileCount) != 1)
+        step++;
+    
+    // the probe tile below is drawn before the controller plans any
+    int threads = std::max(1, std::min(threadCount(), tileCount - 1));
+    QualityController controller(maxDepth, antialias, tileCount - 1, threads, start + timeBudget);
+    vector<int> tileLevels(tileCount);
+    
+    // draws a tile at a level into the image and returns how long it took
+    auto drawTile = [&](int tile, int level)
+    {
+        const QualityLevel &quality = controller.level(level);
+        int left = (tile % tilesAcross) * tileSize;
+        int top = (tile / tilesAcross) * tileSize;
+        int tileWidth = std::min(tileSize, width - left);
+        int tileHeight = std::min(tileSize, height - top);
+        
+        vector<unsigned char> pixels((size_t) tileWidth * tileHeight * 3);
+        double tileStart = now();
+        drawSceneTile(scene, &pixels[0], width, height, left, top, tileWidth, tileHeight,
+                      quality.depth, orthographic, quality.antialias, pattern);
+        double seconds = now() - tileStart;
+        
+        for (int row = 0; row < tileHeight; row++)
+            memcpy(buffer + ((size_t) (top + row) * width + left) * 3,
+                   &pixels[(size_t) row * tileWidth * 3], (size_t) tileWidth * 3);
+        tileLevels[tile] = level;
+        controller.finishTile(level, tileWidth * tileHeight, seconds);
+    };
+    
+    // measure the cheapest level on one tile first, so there is something to plan with.
+    // it is the first tile of the order, so it stays in the image.
+    drawTile(0, 0);
+    
+    parallelFor(1, tileCount, [&](int i)
+    {
+        int tile = (int) ((long long) i * step % tileCount);
+        int left = (tile % tilesAcross) * tileSize;
+        int top = (tile / tilesAcross) * tileSize;
+        int tilePixels = std::min(tileSize, width - left) * std::min(tileSize, height - top);
+        drawTile(tile, controller.startTile(tilePixels));
+    });
+    
+    report.seconds = now() - start;
+    report.tileCount = tileCount;
+    report.minAntialias = report.minDepth = 1 << 30;
+    
+    double samples = 0;
+    for (int tile = 0; tile < tileCount; tile++)
+    {
+        const QualityLevel &quality = controller.level(tileLevels[tile]);
+        int pixels = std::min(tileSize, width - (tile % tilesAcross) * tileSize) *
+                     std::min(tileSize, height - (tile / tilesAcross) * tileSize);
+        samples += (double) pixels * quality.antialias * quality.antialias;
+        
+        if (tileLevels[tile] == controller.topLevel())
+            report.fullQualityTiles++;
+        report.minAntialias = std::min(report.minAntialias, quality.antialias);
+        report.maxAntialias = std::max(report.maxAntialias, quality.antialias);
+        report.minDepth = std::min(report.minDepth, quality.depth);
+        report.maxDepth = std::max(report.maxDepth, quality.depth);
+    }
+    report.averageSamples = samples / ((double) width * height);
+    
+    return report;
+}
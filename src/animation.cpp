@@ -0,0 +1,129 @@
+#include <animation.h>
+#include <bvh.h>
+#include <lodepng.h>
+#include <util.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+Animation::Track &Animation::track(GeometricObject* object, PointLight* light)
+{
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        if (tracks[i].object == object && tracks[i].light == light)
+            return tracks[i];
+    }
+    
+    Track added;
+    added.object = object;
+    added.light = light;
+    if (light)
+        added.lightOrigin = light->location;
+    tracks.push_back(added);
+    return tracks.back();
+}
+
+// adds a keyframe, keeping them in order of time
+static void addKey(vector<Keyframe> &keys, float time, Vector offset)
+{
+    Keyframe key = {time, offset};
+    auto later = std::upper_bound(keys.begin(), keys.end(), key, [](const Keyframe &a, const Keyframe &b)
+    {
+        return a.time < b.time;
+    });
+    keys.insert(later, key);
+}
+
+void Animation::moveObject(GeometricObject* object, float time, Vector offset)
+{
+    addKey(track(object, NULL).keys, time, offset);
+}
+
+void Animation::moveLight(PointLight* light, float time, Vector offset)
+{
+    addKey(track(NULL, light).keys, time, offset);
+}
+
+// the offset keys give at time
+static Vector offsetAt(const vector<Keyframe> &keys, float time)
+{
+    if (time <= keys.front().time)
+        return keys.front().offset;
+    if (time >= keys.back().time)
+        return keys.back().offset;
+    
+    size_t i = 1;
+    while (keys[i].time < time)
+        i++;
+    const Keyframe &a = keys[i - 1], &b = keys[i];
+    float u = (time - a.time) / (b.time - a.time);
+    return a.offset + u * (b.offset - a.offset);
+}
+
+void Animation::setTime(float time)
+{
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        Track &t = tracks[i];
+        Vector offset = offsetAt(t.keys, time);
+        if (t.object)
+            t.object->translate(offset - t.offset);
+        else
+            t.light->location = t.lightOrigin + offset;
+        t.offset = offset;
+    }
+}
+
+float Animation::duration()
+{
+    float last = 0;
+    for (size_t i = 0; i < tracks.size(); i++)
+        last = std::max(last, tracks[i].keys.back().time);
+    return last;
+}
+
+bool drawKeyframes(Scene* scene, Animation &animation, int frames, const char* outputFile, int width, int height,
+                   int maxDepth, bool orthographic, int antialias, SamplePattern pattern, float rebuildRatio,
+                   vector<FrameTimings>* timings)
+{
+    BVH* bvh = NULL;
+    vector<unsigned char> canvas((size_t) width * height * 3);
+    vector<FrameTimings> frameTimings(frames);
+    bool allWritten = true;
+    
+    for (int frame = 0; frame < frames; frame++)
+    {
+        FrameTimings &timing = frameTimings[frame];
+        animation.setTime(frames > 1 ? animation.duration() * frame / (frames - 1) : 0);
+        
+        double start = now();
+        if (bvh)
+            timing.rebuilt = bvh->update();
+        else
+        {
+            bvh = new BVH(scene, rebuildRatio);
+            scene->accelerator = bvh;
+            timing.rebuilt = true;
+        }
+        timing.bvhSeconds = now() - start;
+        
+        start = now();
+        drawScene(scene, &canvas[0], width, height, maxDepth, orthographic, antialias, pattern);
+        timing.renderSeconds = now() - start;
+        
+        char number[16];
+        snprintf(number, sizeof(number), "%04d", frame);
+        std::string frameFile = numberedFileName(outputFile, number);
+        start = now();
+        timing.written = lodepng_encode24_file(frameFile.c_str(), &canvas[0], width, height) == 0;
+        timing.encodeSeconds = now() - start;
+        allWritten = allWritten && timing.written;
+    }
+    
+    // the scene's own accelerator was built for where the objects were before, so leave
+    // it the BVH that fits them now
+    if (timings)
+        *timings = frameTimings;
+    return allWritten;
+}
@@ -0,0 +1,169 @@
+#include <batch.h>
+#include <renderpool.h>
+#include <lodepng.h>
+#include <util.h>
+
+#include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// views being drawn at once. two keep the pool busy while one is written out, without
+// holding every image in memory.
+#define VIEWS_IN_FLIGHT 2
+
+View::View(Scene* scene, std::string name)
+{
+    viewpoint = scene->viewpoint;
+    viewRight = scene->viewRight;
+    viewUp = scene->viewUp;
+    viewPlaneTop = scene->viewPlaneTop;
+    viewPlaneBottom = scene->viewPlaneBottom;
+    viewPlaneLeft = scene->viewPlaneLeft;
+    viewPlaneRight = scene->viewPlaneRight;
+    viewPlaneZ = scene->viewPlaneZ;
+    this->name = name;
+}
+
+void View::apply(Scene* scene) const
+{
+    scene->viewpoint = viewpoint;
+    scene->viewRight = viewRight;
+    scene->viewUp = viewUp;
+    scene->viewPlaneTop = viewPlaneTop;
+    scene->viewPlaneBottom = viewPlaneBottom;
+    scene->viewPlaneLeft = viewPlaneLeft;
+    scene->viewPlaneRight = viewPlaneRight;
+    scene->viewPlaneZ = viewPlaneZ;
+}
+
+vector<View> turntableViews(Scene* scene, Point center, int count)
+{
+    // a scene without objects to move the camera of
+    Scene camera;
+    View(scene, "").apply(&camera);
+    
+    Vector offset = scene->viewpoint - center;
+    float radius = sqrtf(offset.x * offset.x + offset.z * offset.z);
+    float start = atan2f(offset.z, offset.x);
+    
+    vector<View> views;
+    for (int i = 0; i < count; i++)
+    {
+        float angle = start + 2 * (float) M_PI * i / count;
+        Point eye(center.x + radius * cosf(angle), scene->viewpoint.y, center.z + radius * sinf(angle));
+        pointCamera(&camera, eye, center, Vector(0,1,0));
+        char number[16];
+        snprintf(number, sizeof(number), "%04d", i);
+        views.push_back(View(&camera, number));
+    }
+    return views;
+}
+
+vector<View> stereoViews(Scene* scene, float separation)
+{
+    vector<View> views(2, View(scene, "-left"));
+    views[0].viewpoint = scene->viewpoint + (-separation / 2) * scene->viewRight;
+    views[1].viewpoint = scene->viewpoint + (separation / 2) * scene->viewRight;
+    views[1].name = "-right";
+    return views;
+}
+
+vector<View> cubeMapViews(Scene* scene)
+{
+    Scene camera;
+    View(scene, "").apply(&camera);
+    setFieldOfView(&camera, 90, 1);
+    
+    const char* names[6] = {"-px", "-nx", "-py", "-ny", "-pz", "-nz"};
+    Vector directions[6] = {Vector(1,0,0), Vector(-1,0,0), Vector(0,1,0), Vector(0,-1,0), Vector(0,0,1),
+                            Vector(0,0,-1)};
+    // up can't be along the direction, so the views along y have z up
+    Vector ups[6] = {Vector(0,1,0), Vector(0,1,0), Vector(0,0,1), Vector(0,0,-1), Vector(0,1,0), Vector(0,1,0)};
+    
+    vector<View> views;
+    for (int i = 0; i < 6; i++)
+    {
+        pointCamera(&camera, scene->viewpoint, scene->viewpoint + directions[i], ups[i]);
+        views.push_back(View(&camera, names[i]));
+    }
+    return views;
+}
+
+// a view being drawn
+struct ViewInFlight {
+    // the scene with the view's camera. the object and light lists are copies of the
+    // pointers, so the objects themselves are shared.
+    Scene scene;
+    vector<unsigned char> image;
+    RenderJob job;
+    double start;
+};
+
+bool drawViews(Scene* scene, const vector<View> &views, const char* outputFile, int width, int height, int maxDepth,
+               bool orthographic, int antialias, SamplePattern pattern, vector<ViewTimings>* timings)
+{
+    int count = views.size();
+    vector<ViewTimings> viewTimings(count);
+    vector<std::unique_ptr<ViewInFlight> > inFlight(count);
+    
+    // the views the pool has finished, in the order it finished them
+    std::mutex mutex;
+    std::condition_variable viewDone;
+    std::deque<int> finished;
+    
+    RenderPool pool;
+    int submitted = 0;
+    auto submitNext = [&]()
+    {
+        int i = submitted++;
+        inFlight[i].reset(new ViewInFlight);
+        ViewInFlight &view = *inFlight[i];
+        view.scene = *scene;
+        views[i].apply(&view.scene);
+        view.image.resize((size_t) width * height * 3);
+        view.start = now();
+        
+        view.job = pool.submit(&view.scene, &view.image[0], width, height, maxDepth, orthographic, antialias, 64,
+                               pattern);
+        view.job.then([&, i](bool)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            viewTimings[i].renderSeconds = now() - inFlight[i]->start;
+            finished.push_back(i);
+            viewDone.notify_one();
+        });
+    };
+    
+    while (submitted < std::min(count, VIEWS_IN_FLIGHT))
+        submitNext();
+    
+    bool allWritten = true;
+    for (int written = 0; written < count; written++)
+    {
+        int i;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            viewDone.wait(lock, [&]() { return !finished.empty(); });
+            i = finished.front();
+            finished.pop_front();
+        }
+        
+        // start the next view before writing this one, so the pool doesn't run dry
+        if (submitted < count)
+            submitNext();
+        
+        double start = now();
+        std::string file = numberedFileName(outputFile, views[i].name);
+        viewTimings[i].written = lodepng_encode24_file(file.c_str(), &inFlight[i]->image[0], width, height) == 0;
+        viewTimings[i].encodeSeconds = now() - start;
+        allWritten = allWritten && viewTimings[i].written;
+        inFlight[i].reset();
+    }
+    
+    if (timings)
+        *timings = viewTimings;
+    return allWritten;
+}
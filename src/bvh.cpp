@@ -0,0 +1,259 @@
+#include <bvh.h>
+
+#include <algorithm>
+#include <cmath>
+
+// the bins the centroids are sorted into along each axis when looking for a split
+#define BVH_BINS 16
+// what trying a box costs next to trying an object
+#define BVH_TRAVERSAL_COST 1.0f
+// how much each object's box is grown, relative to the size of its coordinates
+#define BVH_PADDING 1e-4f
+
+static inline float centroid(const Bounds &b, int axis)
+{
+    return (coordinate(b.min, axis) + coordinate(b.max, axis)) / 2;
+}
+
+// a coordinate moved away from the middle of a box by the padding
+static inline float pad(float x, float direction)
+{
+    return x + direction * BVH_PADDING * (1 + fabsf(x));
+}
+
+BVH::BVH(Scene* scene, float rebuildRatio)
+{
+    this->scene = scene;
+    this->rebuildRatio = rebuildRatio;
+    build();
+}
+
+size_t BVH::memoryUsed()
+{
+    return nodes.size() * sizeof(Node) + (order.size() + unbounded.size()) * sizeof(int) +
+           objectBounds.size() * sizeof(Bounds);
+}
+
+Bounds paddedBounds(GeometricObject* object)
+{
+    Point min, max;
+    object->getBounds(min, max);
+    return Bounds(Point(pad(min.x, -1), pad(min.y, -1), pad(min.z, -1)),
+                  Point(pad(max.x, 1), pad(max.y, 1), pad(max.z, 1)));
+}
+
+bool isUnbounded(const Bounds &b)
+{
+    return std::isinf(b.min.x) || std::isinf(b.min.y) || std::isinf(b.min.z) ||
+           std::isinf(b.max.x) || std::isinf(b.max.y) || std::isinf(b.max.z);
+}
+
+void BVH::findObjectBounds()
+{
+    objectBounds.resize(scene->objects.size());
+    for (size_t i = 0; i < scene->objects.size(); i++)
+        objectBounds[i] = paddedBounds(scene->objects[i]);
+}
+
+void BVH::build()
+{
+    findObjectBounds();
+    order.clear();
+    unbounded.clear();
+    for (size_t i = 0; i < objectBounds.size(); i++)
+    {
+        if (isUnbounded(objectBounds[i]))
+            unbounded.push_back(i);
+        else
+            order.push_back(i);
+    }
+    
+    nodes.clear();
+    if (!order.empty())
+        buildNode(0, order.size(), 1);
+    builtCost = cost();
+}
+
+int partitionObjects(int* objects, int count, const vector<Bounds> &objectBounds, const Bounds &bounds)
+{
+    if (count == 1)
+        return 0;
+    
+    Bounds centroids;
+    for (int i = 0; i < count; i++)
+    {
+        const Bounds &b = objectBounds[objects[i]];
+        Point c(centroid(b, XAXIS), centroid(b, YAXIS), centroid(b, ZAXIS));
+        centroids.add(Bounds(c, c));
+    }
+    
+    // the cheapest split between bins, along any axis
+    float leafCost = count, bestCost = INFINITY;
+    int bestAxis = -1, bestBin = 0;
+    float parentArea = std::max(area(bounds), 1e-20f);
+    
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float low = coordinate(centroids.min, axis), extent = coordinate(centroids.max, axis) - low;
+        if (extent <= 0)
+            continue;
+        
+        Bounds binBounds[BVH_BINS];
+        int binCounts[BVH_BINS] = {0};
+        for (int i = 0; i < count; i++)
+        {
+            const Bounds &b = objectBounds[objects[i]];
+            int bin = std::min(BVH_BINS - 1, (int) ((centroid(b, axis) - low) * BVH_BINS / extent));
+            binBounds[bin].add(b);
+            binCounts[bin]++;
+        }
+        
+        // the area and count of everything below each split, then above it
+        float belowArea[BVH_BINS - 1];
+        int belowCount[BVH_BINS - 1];
+        Bounds below;
+        int n = 0;
+        for (int bin = 0; bin < BVH_BINS - 1; bin++)
+        {
+            below.add(binBounds[bin]);
+            n += binCounts[bin];
+            belowArea[bin] = n ? area(below) : 0;
+            belowCount[bin] = n;
+        }
+        
+        Bounds above;
+        n = 0;
+        for (int bin = BVH_BINS - 1; bin > 0; bin--)
+        {
+            above.add(binBounds[bin]);
+            n += binCounts[bin];
+            int split = bin - 1;
+            if (n == 0 || belowCount[split] == 0)
+                continue;
+            float cost = BVH_TRAVERSAL_COST + (belowArea[split] * belowCount[split] + area(above) * n) / parentArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = split;
+            }
+        }
+    }
+    
+    if (bestAxis < 0 || (bestCost >= leafCost && count <= BVH_LEAF_SIZE))
+        return 0;
+    
+    float low = coordinate(centroids.min, bestAxis);
+    float extent = coordinate(centroids.max, bestAxis) - low;
+    int* middle = std::partition(objects, objects + count, [&](int object)
+    {
+        float c = centroid(objectBounds[object], bestAxis);
+        return std::min(BVH_BINS - 1, (int) ((c - low) * BVH_BINS / extent)) <= bestBin;
+    });
+    return middle - objects;
+}
+
+int BVH::buildNode(int first, int count, int depth)
+{
+    int index = nodes.size();
+    nodes.push_back(Node());
+    
+    Bounds bounds;
+    for (int i = first; i < first + count; i++)
+        bounds.add(objectBounds[order[i]]);
+    nodes[index].bounds = bounds;
+    nodes[index].first = first;
+    nodes[index].count = count;
+    
+    int belowCount = depth < BVH_MAX_DEPTH ? partitionObjects(&order[first], count, objectBounds, bounds) : 0;
+    if (belowCount == 0)
+        return index;
+    
+    buildNode(first, belowCount, depth + 1);
+    int second = buildNode(first + belowCount, count - belowCount, depth + 1);
+    nodes[index].first = second;
+    nodes[index].count = 0;
+    return index;
+}
+
+void BVH::refit()
+{
+    findObjectBounds();
+    
+    // children come after their parents
+    for (int i = nodes.size() - 1; i >= 0; i--)
+    {
+        Node &node = nodes[i];
+        Bounds bounds;
+        if (node.count > 0)
+        {
+            for (int j = node.first; j < node.first + node.count; j++)
+                bounds.add(objectBounds[order[j]]);
+        }
+        else
+        {
+            bounds = nodes[i + 1].bounds;
+            bounds.add(nodes[node.first].bounds);
+        }
+        node.bounds = bounds;
+    }
+}
+
+bool BVH::update()
+{
+    refit();
+    if (cost() <= rebuildRatio * builtCost)
+        return false;
+    build();
+    return true;
+}
+
+float BVH::cost()
+{
+    if (nodes.empty())
+        return 0;
+    
+    float total = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+        total += area(nodes[i].bounds) * (nodes[i].count > 0 ? nodes[i].count : BVH_TRAVERSAL_COST);
+    return total / std::max(area(nodes[0].bounds), 1e-20f);
+}
+
+void tryObject(Scene* scene, int index, Ray* ray, Intersection* &closest, int &closestIndex)
+{
+    Intersection* intersection = scene->objects[index]->intersect(ray);
+    if (!intersection)
+        return;
+    
+    // of equally close objects the one first in the scene wins, as it does when trying them in order
+    if (!closest || intersection->t < closest->t || (intersection->t == closest->t && index < closestIndex))
+    {
+        if (closest) delete closest;
+        closest = intersection;
+        closestIndex = index;
+    }
+    else
+        delete intersection;
+}
+
+Intersection* BVH::findFirstIntersection(Ray* ray)
+{
+    Intersection* closest = NULL;
+    int closestIndex = 0;
+    
+    for (size_t i = 0; i < unbounded.size(); i++)
+        tryObject(scene, unbounded[i], ray, closest, closestIndex);
+    
+    if (nodes.empty())
+        return closest;
+    
+    // a branch's first child is right after it
+    findInTree(scene, ray, &nodes[0], &order[0], [&](int node, int &a, int &b)
+    {
+        const Node &n = nodes[node];
+        a = node + 1;
+        b = n.first;
+        return n.count == 0;
+    }, closest, closestIndex);
+    return closest;
+}
@@ -0,0 +1,185 @@
+#include <camera.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * The rays of a batch are handled one coordinate at a time, four floats to an SSE
+ * register where SSE2 is available, and plain floats elsewhere. Only operations that
+ * round exactly like their scalar versions (no reciprocal estimates) are used, so the
+ * rays are the same either way.
+ */
+#ifdef __SSE2__
+typedef __m128 Vec4;
+
+static inline Vec4 load4(const float* p) { return _mm_loadu_ps(p); }
+static inline void store4(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 splat(float a) { return _mm_set1_ps(a); }
+static inline Vec4 set4(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+static inline Vec4 add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+static inline Vec4 mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+static inline Vec4 div(Vec4 a, Vec4 b) { return _mm_div_ps(a, b); }
+static inline Vec4 sqrt4(Vec4 a) { return _mm_sqrt_ps(a); }
+#else
+struct Vec4 { float v[4]; };
+
+static inline Vec4 load4(const float* p) { Vec4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+static inline void store4(float* p, Vec4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline Vec4 splat(float a) { Vec4 r = {{a, a, a, a}}; return r; }
+static inline Vec4 set4(float a, float b, float c, float d) { Vec4 r = {{a, b, c, d}}; return r; }
+static inline Vec4 add(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline Vec4 mul(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline Vec4 div(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] /= b.v[i]; return a; }
+static inline Vec4 sqrt4(Vec4 a) { for (int i = 0; i < 4; i++) a.v[i] = sqrtf(a.v[i]); return a; }
+#endif
+
+Camera::Camera(Scene* scene, int width, int height, bool orthographic, int antialias)
+{
+    viewpoint = scene->viewpoint;
+    right = scene->viewRight;
+    up = scene->viewUp;
+    back = cross(right, up);
+    forward = cross(up, right);
+    planeZ = scene->viewPlaneZ;
+    k = antialias + 1;
+    
+    float viewWidth  = scene->viewPlaneRight - scene->viewPlaneLeft;
+    float viewHeight = scene->viewPlaneTop   - scene->viewPlaneBottom;
+    pixWidth  = (viewWidth  / width );
+    pixHeight = (viewHeight / height);
+    float pixWidthOverK  = pixWidth  / k;
+    float pixHeightOverK = pixHeight / k;
+    
+    columnLefts.resize(width);
+    sampleXs.resize((size_t) width * (k - 1));
+    for (int x = 0; x < width; x++)
+    {
+        columnLefts[x] = scene->viewPlaneLeft + (pixWidth * x);
+        for (int j = 1; j < k; j++)
+            sampleXs[(size_t) x * (k - 1) + j - 1] = columnLefts[x] + (j * pixWidthOverK);
+    }
+    
+    rowBottoms.resize(height);
+    sampleYs.resize((size_t) height * (k - 1));
+    for (int y = 0; y < height; y++)
+    {
+        rowBottoms[y] = scene->viewPlaneBottom + (pixHeight * y);
+        for (int i = 1; i < k; i++)
+            sampleYs[(size_t) y * (k - 1) + i - 1] = rowBottoms[y] + (i * pixHeightOverK);
+    }
+    
+    kernel = orthographic ? makeRaysKernel<true> : makeRaysKernel<false>;
+}
+
+// the scene coordinate along one axis of a vector given in camera coordinates (x, y, z),
+// for the camera axes' coordinates along that axis
+static inline Vec4 turn(float right, float up, float back, Vec4 x, Vec4 y, Vec4 z)
+{
+    return add(add(mul(splat(right), x), mul(splat(up), y)), mul(splat(back), z));
+}
+
+// turn for a single vector
+static inline float turn(float right, float up, float back, float x, float y, float z)
+{
+    return right * x + up * y + back * z;
+}
+
+template<bool Orthographic>
+void Camera::makeRaysKernel(const Camera &camera, const float* planeX, const float* planeY, int count, Ray* rays)
+{
+    const Vector &right = camera.right, &up = camera.up, &back = camera.back;
+    
+    for (int first = 0; first < count; first += 4)
+    {
+        int n = std::min(4, count - first);
+        
+        // a single ray is quicker on its own, in the same steps
+        if (n == 1)
+        {
+            float x = planeX[first], y = planeY[first], z = camera.planeZ;
+            Ray &ray = rays[first];
+            ray.origin = Point(camera.viewpoint.x + turn(right.x, up.x, back.x, x, y, z),
+                               camera.viewpoint.y + turn(right.y, up.y, back.y, x, y, z),
+                               camera.viewpoint.z + turn(right.z, up.z, back.z, x, y, z));
+            if (Orthographic)
+                ray.direction = camera.forward;
+            else
+            {
+                float length = sqrtf(x * x + y * y + z * z);
+                x /= length;
+                y /= length;
+                z /= length;
+                ray.direction = Vector(turn(right.x, up.x, back.x, x, y, z), turn(right.y, up.y, back.y, x, y, z),
+                                       turn(right.z, up.z, back.z, x, y, z));
+            }
+            continue;
+        }
+        
+        // a short batch repeats its last point
+        const float *xs = planeX + first, *ys = planeY + first;
+        Vec4 x, y, z = splat(camera.planeZ);
+        if (n == 4)
+        {
+            x = load4(xs);
+            y = load4(ys);
+        }
+        else
+        {
+            int b = std::min(1, n - 1), c = std::min(2, n - 1);
+            x = set4(xs[0], xs[b], xs[c], xs[n - 1]);
+            y = set4(ys[0], ys[b], ys[c], ys[n - 1]);
+        }
+        
+        // rays start on the view plane
+        float origins[3][4];
+        store4(origins[0], add(splat(camera.viewpoint.x), turn(right.x, up.x, back.x, x, y, z)));
+        store4(origins[1], add(splat(camera.viewpoint.y), turn(right.y, up.y, back.y, x, y, z)));
+        store4(origins[2], add(splat(camera.viewpoint.z), turn(right.z, up.z, back.z, x, y, z)));
+        
+        if (Orthographic)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                rays[first + i].origin = Point(origins[0][i], origins[1][i], origins[2][i]);
+                rays[first + i].direction = camera.forward;
+            }
+            continue;
+        }
+        
+        // the direction from the viewpoint, normalized in the same steps as Vector::normalize
+        Vec4 length = sqrt4(add(add(mul(x, x), mul(y, y)), mul(z, z)));
+        Vec4 dx = div(x, length), dy = div(y, length), dz = div(z, length);
+        
+        float directions[3][4];
+        store4(directions[0], turn(right.x, up.x, back.x, dx, dy, dz));
+        store4(directions[1], turn(right.y, up.y, back.y, dx, dy, dz));
+        store4(directions[2], turn(right.z, up.z, back.z, dx, dy, dz));
+        
+        for (int i = 0; i < n; i++)
+        {
+            rays[first + i].origin = Point(origins[0][i], origins[1][i], origins[2][i]);
+            rays[first + i].direction = Vector(directions[0][i], directions[1][i], directions[2][i]);
+        }
+    }
+}
+
+void pointCamera(Scene* scene, Point eye, Point target, Vector up)
+{
+    Vector forward = (target - eye).normalize();
+    scene->viewpoint = eye;
+    scene->viewRight = cross(forward, up).normalize();
+    scene->viewUp = cross(scene->viewRight, forward);
+}
+
+void setFieldOfView(Scene* scene, float degrees, float aspect)
+{
+    float halfHeight = -scene->viewPlaneZ * tanf(degrees * (float) M_PI / 360);
+    scene->viewPlaneTop = halfHeight;
+    scene->viewPlaneBottom = -halfHeight;
+    scene->viewPlaneRight = halfHeight * aspect;
+    scene->viewPlaneLeft = -halfHeight * aspect;
+}
@@ -0,0 +1,185 @@
+#include <raytrace_c.h>
+#include <trace.h>
+#include <parallel.h>
+
+#include <atomic>
+#include <mutex>
+
+struct rt_scene {
+    Scene scene;
+    // pixels of the textures added to the scene, which it owns
+    vector<Color*> textures;
+};
+
+static Color toColor(const float c[3])
+{
+    return Color(c[0], c[1], c[2]);
+}
+
+static Point toPoint(const float p[3])
+{
+    return Point(p[0], p[1], p[2]);
+}
+
+static Vector toVector(const float v[3])
+{
+    return Vector(v[0], v[1], v[2]);
+}
+
+static Material toMaterial(const rt_material* m)
+{
+    Material material;
+    material.ambient = toColor(m->ambient);
+    material.diffuse = toColor(m->diffuse);
+    material.specular = toColor(m->specular);
+    material.refracted = toColor(m->refracted);
+    material.emission = toColor(m->emission);
+    material.shininess = m->shininess;
+    return material;
+}
+
+int rt_api_version(void)
+{
+    return RT_API_VERSION;
+}
+
+rt_scene* rt_scene_create(void)
+{
+    rt_scene* s = new rt_scene;
+    s->scene.backgroundColor = Color(0,0,0);
+    s->scene.ambientLight = Color(0,0,0);
+    s->scene.viewPlaneTop = 1;
+    s->scene.viewPlaneBottom = -1;
+    s->scene.viewPlaneLeft = -1;
+    s->scene.viewPlaneRight = 1;
+    s->scene.viewPlaneZ = -1;
+    return s;
+}
+
+void rt_scene_destroy(rt_scene* s)
+{
+    if (!s)
+        return;
+    
+    for (size_t i = 0; i < s->scene.objects.size(); i++)
+        delete s->scene.objects[i];
+    for (size_t i = 0; i < s->scene.pointLights.size(); i++)
+        delete s->scene.pointLights[i];
+    for (size_t i = 0; i < s->scene.directionalLights.size(); i++)
+        delete s->scene.directionalLights[i];
+    for (size_t i = 0; i < s->textures.size(); i++)
+        delete[] s->textures[i];
+    delete s;
+}
+
+void rt_scene_set_background(rt_scene* s, const float color[3])
+{
+    s->scene.backgroundColor = toColor(color);
+}
+
+void rt_scene_set_ambient_light(rt_scene* s, const float color[3])
+{
+    s->scene.ambientLight = toColor(color);
+}
+
+void rt_scene_set_view_plane(rt_scene* s, float top, float bottom, float left, float right, float z)
+{
+    s->scene.viewPlaneTop = top;
+    s->scene.viewPlaneBottom = bottom;
+    s->scene.viewPlaneLeft = left;
+    s->scene.viewPlaneRight = right;
+    s->scene.viewPlaneZ = z;
+}
+
+void rt_scene_add_sphere(rt_scene* s, const rt_material* material, const float center[3], float radius)
+{
+    s->scene.objects.push_back(new Sphere(toMaterial(material), toPoint(center), radius));
+}
+
+void rt_scene_add_plane(rt_scene* s, const rt_material* material, const float point[3], const float normal[3])
+{
+    s->scene.objects.push_back(new Plane(toMaterial(material), toPoint(point), toVector(normal)));
+}
+
+void rt_scene_add_rectangle(rt_scene* s, const rt_material* material,
+                            const float min[3], const float max[3], const float normal[3])
+{
+    s->scene.objects.push_back(new Rectangle(toMaterial(material), max[0], min[0], max[1], min[1],
+                                             max[2], min[2], toVector(normal)));
+}
+
+void rt_scene_add_textured_rectangle(rt_scene* s, const rt_material* material,
+                                     const unsigned char* pixels, int textureWidth, int textureHeight,
+                                     int sAxis, int tAxis,
+                                     const float min[3], const float max[3], const float normal[3])
+{
+    Texture texture = makeTexture(pixels, textureWidth, textureHeight);
+    s->textures.push_back(texture.pixels);
+    s->scene.objects.push_back(new TexturedRectangle(toMaterial(material), texture, sAxis, tAxis,
+                                                     max[0], min[0], max[1], min[1], max[2], min[2],
+                                                     toVector(normal)));
+}
+
+void rt_scene_add_point_light(rt_scene* s, const float color[3], const float location[3])
+{
+    PointLight* light = new PointLight;
+    light->color = toColor(color);
+    light->location = toPoint(location);
+    s->scene.pointLights.push_back(light);
+}
+
+void rt_scene_add_directional_light(rt_scene* s, const float color[3], const float direction[3])
+{
+    DirectionalLight* light = new DirectionalLight;
+    light->color = toColor(color);
+    light->direction = toVector(direction).normalize();
+    s->scene.directionalLights.push_back(light);
+}
+
+int rt_render(const rt_scene* s, const rt_render_settings* settings,
+              unsigned char* buffer, size_t rowStride,
+              rt_progress_callback progress, rt_cancel_callback cancel, void* userData)
+{
+    if (!s || !settings || !buffer || settings->width < 1 || settings->height < 1 ||
+        settings->antialias < 1 || settings->max_depth < 0)
+        return RT_INVALID_ARGUMENT;
+    
+    int width = settings->width;
+    int height = settings->height;
+    if (rowStride == 0)
+        rowStride = (size_t) width * 3;
+    else if (rowStride < (size_t) width * 3)
+        return RT_INVALID_ARGUMENT;
+    
+    // drawing only reads the scene
+    Scene* scene = const_cast<Scene*>(&s->scene);
+    
+    std::mutex callbackMutex;
+    std::atomic<bool> cancelled(false);
+    int rowsDone = 0;
+    
+    parallelFor(0, height, [&](int row)
+    {
+        if (cancelled)
+            return;
+        if (cancel)
+        {
+            std::lock_guard<std::mutex> lock(callbackMutex);
+            if (cancel(userData))
+            {
+                cancelled = true;
+                return;
+            }
+        }
+        
+        drawSceneRows(scene, buffer + row * rowStride, width, height, row, 1,
+                      settings->max_depth, settings->orthographic, settings->antialias);
+        
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        rowsDone++;
+        if (progress)
+            progress(userData, rowsDone, height);
+    });
+    
+    return cancelled ? RT_CANCELLED : RT_OK;
+}
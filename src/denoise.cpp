@@ -0,0 +1,257 @@
+#include <denoise.h>
+#include <parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// how far apart colors may be, as the squared distance at which the weight drops to
+// 1/e, in the first pass. later passes halve it, so they only smooth what is left of
+// the noise instead of washing out shading.
+#define COLOR_PHI 0.01f
+// the depth difference at which the weight drops to 1/e, relative to the depth and
+// per pixel of distance
+#define DEPTH_PHI 0.01f
+// normals are compared by dot(n, m)^NORMAL_POWER
+#define NORMAL_POWER 16
+// neighbours count as a different surface if their normals are further apart than
+// this cosine or their depths differ by more than this fraction
+#define EDGE_COSINE 0.9f
+#define EDGE_DEPTH 0.05f
+// or their (clamped) colors differ by more than this in any channel, which finds
+// shadow and texture edges within a surface
+#define EDGE_CONTRAST 0.1f
+
+/*
+ * Colors are handled as four floats (r, g, b and 0), which is one SSE register where
+ * SSE2 is available, and plain floats elsewhere.
+ */
+#ifdef __SSE2__
+typedef __m128 Vec4;
+
+static inline Vec4 load4(const float* p) { return _mm_loadu_ps(p); }
+static inline void store4(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 splat(float a) { return _mm_set1_ps(a); }
+static inline Vec4 add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+static inline Vec4 sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+static inline Vec4 mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+
+// the sum of all four lanes
+static inline float sum4(Vec4 v)
+{
+    Vec4 pairs = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_movehl_ps(pairs, pairs)));
+}
+#else
+struct Vec4 { float v[4]; };
+
+static inline Vec4 load4(const float* p) { Vec4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+static inline void store4(float* p, Vec4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline Vec4 splat(float a) { Vec4 r = {{a, a, a, a}}; return r; }
+static inline Vec4 add(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline Vec4 sub(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline Vec4 mul(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline float sum4(Vec4 a) { return a.v[0] + a.v[1] + a.v[2] + a.v[3]; }
+#endif
+
+// one pass of the filter with taps step pixels apart, from in to out (four floats per pixel)
+static void filterPass(const float* in, float* out, int width, int height, const RenderOutputs &guides,
+                       int step, float colorPhi)
+{
+    // the B3 spline kernel 1/16, 1/4, 3/8, 1/4, 1/16, indexed by distance
+    static const float kernel[3] = {3.0f / 8, 1.0f / 4, 1.0f / 16};
+    
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t p = (size_t) y * width + x;
+            Vec4 center = load4(in + p * 4);
+            Vec4 sum = splat(0);
+            float weightSum = 0;
+            
+            for (int dy = -2; dy <= 2; dy++)
+            {
+                int qy = y + dy * step;
+                if (qy < 0 || qy >= height)
+                    continue;
+                
+                for (int dx = -2; dx <= 2; dx++)
+                {
+                    int qx = x + dx * step;
+                    if (qx < 0 || qx >= width)
+                        continue;
+                    
+                    size_t q = (size_t) qy * width + qx;
+                    float weight = kernel[dy < 0 ? -dy : dy] * kernel[dx < 0 ? -dx : dx];
+                    // the sum of everything that goes into the exponent, for a single exp
+                    float exponent = 0;
+                    
+                    if (guides.objectId && guides.objectId[q] != guides.objectId[p])
+                        continue;
+                    
+                    if (guides.normal)
+                    {
+                        const float* n = guides.normal + p * 3;
+                        const float* m = guides.normal + q * 3;
+                        float cosine = n[0] * m[0] + n[1] * m[1] + n[2] * m[2];
+                        // pixels that hit nothing have no normal
+                        bool missed = n[0] == 0 && n[1] == 0 && n[2] == 0;
+                        if (!missed)
+                        {
+                            if (cosine <= 0)
+                                continue;
+                            for (int i = 1; i < NORMAL_POWER; i *= 2)
+                                cosine *= cosine;
+                            weight *= cosine;
+                        }
+                    }
+                    
+                    if (guides.depth)
+                    {
+                        float zp = guides.depth[p], zq = guides.depth[q];
+                        if (std::isinf(zp) != std::isinf(zq))
+                            continue;
+                        if (!std::isinf(zp))
+                            exponent += fabsf(zp - zq) / (DEPTH_PHI * zp * step + 1e-4f);
+                    }
+                    
+                    Vec4 color = load4(in + q * 4);
+                    Vec4 diff = sub(color, center);
+                    exponent += sum4(mul(diff, diff)) / colorPhi;
+                    
+                    weight *= expf(-exponent);
+                    sum = add(sum, mul(splat(weight), color));
+                    weightSum += weight;
+                }
+            }
+            
+            // the center pixel always has a positive weight
+            store4(out + p * 4, mul(sum, splat(1 / weightSum)));
+        }
+    });
+}
+
+// whether the guides show a different surface at q than at p
+static bool differentSurface(const RenderOutputs &guides, size_t p, size_t q)
+{
+    if (guides.objectId && guides.objectId[p] != guides.objectId[q])
+        return true;
+    
+    if (guides.normal)
+    {
+        const float* n = guides.normal + p * 3;
+        const float* m = guides.normal + q * 3;
+        if (n[0] * m[0] + n[1] * m[1] + n[2] * m[2] < EDGE_COSINE)
+            return true;
+    }
+    
+    if (guides.depth)
+    {
+        float zp = guides.depth[p], zq = guides.depth[q];
+        if (std::isinf(zp) != std::isinf(zq))
+            return true;
+        if (!std::isinf(zp) && fabsf(zp - zq) > EDGE_DEPTH * std::min(zp, zq))
+            return true;
+    }
+    
+    return false;
+}
+
+void denoise(float* colors, int width, int height, const RenderOutputs &guides, int passes)
+{
+    size_t pixels = (size_t) width * height;
+    vector<float> a(pixels * 4), b(pixels * 4);
+    
+    // filter the lighting rather than the lit color where the albedo is known, so
+    // textures don't get blurred
+    vector<float> albedo(pixels * 3, 1.0f);
+    if (guides.albedo)
+    {
+        for (size_t i = 0; i < pixels * 3; i++)
+            albedo[i] = guides.albedo[i] > 0.01f ? guides.albedo[i] : 1.0f;
+    }
+    
+    for (size_t i = 0; i < pixels; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            a[i * 4 + c] = colors[i * 3 + c] / albedo[i * 3 + c];
+        a[i * 4 + 3] = 0;
+    }
+    
+    float colorPhi = COLOR_PHI;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        filterPass(&a[0], &b[0], width, height, guides, 1 << pass, colorPhi);
+        a.swap(b);
+        colorPhi /= 2;
+    }
+    
+    for (size_t i = 0; i < pixels; i++)
+        for (int c = 0; c < 3; c++)
+            colors[i * 3 + c] = a[i * 4 + c] * albedo[i * 3 + c];
+}
+
+// the largest difference between the color channels of two pixels
+static float contrast(const float* colors, size_t p, size_t q)
+{
+    float result = 0;
+    for (int c = 0; c < 3; c++)
+        result = std::max(result, fabsf(std::min(colors[p * 3 + c], 1.0f) - std::min(colors[q * 3 + c], 1.0f)));
+    return result;
+}
+
+int redrawEdges(Scene* scene, float* colors, int width, int height, const RenderOutputs &guides,
+                int maxDepth, bool orthographic, int antialiasFactor, SamplePattern pattern)
+{
+    // find all the edges before changing any colors
+    vector<unsigned char> edges((size_t) width * height);
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            // an edge that only clips a corner of the pixel shows in the diagonal neighbour
+            size_t p = (size_t) y * width + x;
+            bool edge = false;
+            for (int dy = -1; dy <= 1 && !edge; dy++)
+            {
+                for (int dx = -1; dx <= 1 && !edge; dx++)
+                {
+                    int qx = x + dx, qy = y + dy;
+                    if (qx >= 0 && qx < width && qy >= 0 && qy < height)
+                    {
+                        size_t q = (size_t) qy * width + qx;
+                        edge = differentSurface(guides, p, q) || contrast(colors, p, q) > EDGE_CONTRAST;
+                    }
+                }
+            }
+            edges[p] = edge;
+        }
+    });
+    
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialiasFactor, pattern);
+    std::atomic<int> redrawn(0);
+    
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t p = (size_t) y * width + x;
+            if (!edges[p])
+                continue;
+            
+            Color c;
+            sampler.drawPixel(x, y, c);
+            colors[p * 3 + 0] = c.r;
+            colors[p * 3 + 1] = c.g;
+            colors[p * 3 + 2] = c.b;
+            redrawn++;
+        }
+    });
+    
+    return redrawn;
+}
@@ -0,0 +1,361 @@
+#include <distributed.h>
+#include <trace.h>
+#include <net.h>
+#include <parallel.h>
+#include <util.h>
+
+#include <algorithm>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+
+/*
+ * Messages are an 8-byte header of two 32-bit numbers in network byte order, the
+ * message type and the length of the payload, followed by the payload. Numbers in
+ * payloads are 32-bit and in network byte order too.
+ *
+ *   SETTINGS  coordinator -> worker  width, height, maxDepth, orthographic, antialiasFactor,
+ *                                    samplePattern, pixelFilter
+ *   TILE      coordinator -> worker  tile id, left, top, width, height
+ *   RESULT    worker -> coordinator  tile id, left, top, width, height, then the pixels
+ *   DONE      coordinator -> worker  nothing; the worker exits
+ */
+#define MSG_SETTINGS 1
+#define MSG_TILE     2
+#define MSG_RESULT   3
+#define MSG_DONE     4
+
+#define HEADER_SIZE 8
+#define TILE_FIELDS 5
+
+static bool sendMessage(int fd, unsigned type, const unsigned* fields, int numFields,
+                        const unsigned char* data = NULL, size_t dataLength = 0)
+{
+    vector<unsigned> words(2 + numFields);
+    words[0] = htonl(type);
+    words[1] = htonl(numFields * 4 + dataLength);
+    for (int i = 0; i < numFields; i++)
+        words[2 + i] = htonl(fields[i]);
+    
+    return sendAll(fd, &words[0], words.size() * 4) && (dataLength == 0 || sendAll(fd, data, dataLength));
+}
+
+static unsigned readWord(const unsigned char* p)
+{
+    unsigned word;
+    memcpy(&word, p, 4);
+    return ntohl(word);
+}
+
+/*************************************************
+ ****************** COORDINATOR ******************
+ *************************************************/
+
+struct TileJob {
+    int left, top, width, height;
+    bool done;
+    // how many workers are drawing it right now, and since when the latest one is
+    int workers;
+    double assignedAt;
+};
+
+struct WorkerConnection {
+    int fd;
+    // bytes received that don't form a whole message yet
+    vector<unsigned char> input;
+    // the tile being drawn, or -1 if idle
+    int tile;
+};
+
+// picks the tile an idle worker should draw next: one nobody is drawing, or else the
+// one that has been stalled the longest. returns -1 if there's nothing to do.
+static int nextTile(vector<TileJob> &tiles, double stallTimeout)
+{
+    int stalled = -1;
+    double t = now();
+    
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        TileJob &job = tiles[i];
+        if (job.done)
+            continue;
+        if (job.workers == 0)
+            return i;
+        if (t - job.assignedAt > stallTimeout && (stalled < 0 || job.assignedAt < tiles[stalled].assignedAt))
+            stalled = i;
+    }
+    
+    return stalled;
+}
+
+static void assignTile(WorkerConnection &worker, vector<TileJob> &tiles, double stallTimeout)
+{
+    int id = nextTile(tiles, stallTimeout);
+    if (id < 0)
+        return;
+    
+    TileJob &job = tiles[id];
+    unsigned fields[TILE_FIELDS] = {(unsigned) id, (unsigned) job.left, (unsigned) job.top,
+                                    (unsigned) job.width, (unsigned) job.height};
+    if (!sendMessage(worker.fd, MSG_TILE, fields, TILE_FIELDS))
+        return;
+    
+    worker.tile = id;
+    job.workers++;
+    job.assignedAt = now();
+}
+
+// handles the complete messages in a worker's input. returns the number of tiles finished.
+static int processInput(WorkerConnection &worker, vector<TileJob> &tiles, DistributedSettings &settings,
+                        unsigned char* buffer)
+{
+    int finished = 0;
+    size_t pos = 0;
+    
+    while (worker.input.size() - pos >= HEADER_SIZE)
+    {
+        unsigned type = readWord(&worker.input[pos]);
+        size_t length = readWord(&worker.input[pos + 4]);
+        if (worker.input.size() - pos - HEADER_SIZE < length)
+            break;
+        
+        const unsigned char* payload = &worker.input[pos + HEADER_SIZE];
+        pos += HEADER_SIZE + length;
+        
+        if (type != MSG_RESULT || length < TILE_FIELDS * 4)
+            continue;
+        
+        unsigned id = readWord(payload);
+        if (id >= tiles.size())
+            continue;
+        
+        TileJob &job = tiles[id];
+        if (worker.tile == (int) id)
+        {
+            worker.tile = -1;
+            job.workers--;
+        }
+        
+        // a stalled tile may come back twice; the first copy wins
+        size_t rowBytes = job.width * 3;
+        if (job.done || length != TILE_FIELDS * 4 + rowBytes * job.height)
+            continue;
+        
+        const unsigned char* pixels = payload + TILE_FIELDS * 4;
+        for (int row = 0; row < job.height; row++)
+        {
+            size_t offset = ((size_t) (job.top + row) * settings.width + job.left) * 3;
+            memcpy(buffer + offset, pixels + row * rowBytes, rowBytes);
+        }
+        
+        job.done = true;
+        finished++;
+    }
+    
+    worker.input.erase(worker.input.begin(), worker.input.begin() + pos);
+    return finished;
+}
+
+bool coordinateRender(const char* address, DistributedSettings settings, int localWorkers,
+                      SceneFactory createScene, unsigned char* buffer)
+{
+    // the image couldn't be split into tiles
+    if (settings.tileSize <= 0)
+        return false;
+    
+    int listener = listenOn(address);
+    if (listener < 0)
+        return false;
+    
+    vector<pid_t> children;
+    for (int i = 0; i < localWorkers; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(listener);
+            _exit(runWorker(address, createScene) ? 0 : 1);
+        }
+        if (pid > 0)
+            children.push_back(pid);
+    }
+    
+    vector<TileJob> tiles;
+    for (int top = 0; top < settings.height; top += settings.tileSize)
+    {
+        for (int left = 0; left < settings.width; left += settings.tileSize)
+        {
+            TileJob job;
+            job.left = left;
+            job.top = top;
+            job.width = std::min(settings.tileSize, settings.width - left);
+            job.height = std::min(settings.tileSize, settings.height - top);
+            job.done = false;
+            job.workers = 0;
+            job.assignedAt = 0;
+            tiles.push_back(job);
+        }
+    }
+    
+    unsigned settingsFields[7] = {(unsigned) settings.width, (unsigned) settings.height,
+                                  (unsigned) settings.maxDepth, (unsigned) settings.orthographic,
+                                  (unsigned) settings.antialiasFactor, (unsigned) settings.samplePattern,
+                                  (unsigned) settings.pixelFilter};
+    
+    vector<WorkerConnection> workers;
+    size_t tilesLeft = tiles.size();
+    
+    while (tilesLeft > 0)
+    {
+        vector<struct pollfd> fds(workers.size() + 1);
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            fds[i + 1].fd = workers[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        
+        // wake up regularly to look for stalled tiles
+        poll(&fds[0], fds.size(), 100);
+        
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0 && sendMessage(fd, MSG_SETTINGS, settingsFields, 7))
+            {
+                WorkerConnection worker;
+                worker.fd = fd;
+                worker.tile = -1;
+                workers.push_back(worker);
+            }
+            else if (fd >= 0)
+                close(fd);
+        }
+        
+        // fds[i + 1] belongs to workers[i], so only drop closed connections after the loop
+        size_t polled = workers.size();
+        for (size_t i = 0; i < polled; i++)
+        {
+            WorkerConnection &worker = workers[i];
+            
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                unsigned char chunk[65536];
+                ssize_t n = recv(worker.fd, chunk, sizeof(chunk), 0);
+                if (n <= 0)
+                {
+                    // whatever it was drawing goes back to the others
+                    if (worker.tile >= 0)
+                        tiles[worker.tile].workers--;
+                    close(worker.fd);
+                    worker.fd = -1;
+                    continue;
+                }
+                
+                worker.input.insert(worker.input.end(), chunk, chunk + n);
+                tilesLeft -= processInput(worker, tiles, settings, buffer);
+            }
+        }
+        
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (workers[i].fd < 0)
+            {
+                workers.erase(workers.begin() + i);
+                i--;
+            }
+            else if (workers[i].tile < 0 && tilesLeft > 0)
+                assignTile(workers[i], tiles, settings.stallTimeout);
+        }
+    }
+    
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        sendMessage(workers[i].fd, MSG_DONE, NULL, 0);
+        close(workers[i].fd);
+    }
+    
+    close(listener);
+    unlinkAddress(address);
+    
+    for (size_t i = 0; i < children.size(); i++)
+        waitpid(children[i], NULL, 0);
+    
+    return true;
+}
+
+/*************************************************
+ ******************** WORKER *********************
+ *************************************************/
+
+bool runWorker(const char* address, SceneFactory createScene)
+{
+    int fd = connectTo(address);
+    if (fd < 0)
+        return false;
+    
+    Scene* scene = createScene();
+    DistributedSettings settings;
+    bool haveSettings = false;
+    vector<unsigned char> payload, pixels;
+    
+    for (;;)
+    {
+        unsigned char header[HEADER_SIZE];
+        if (!recvAll(fd, header, HEADER_SIZE))
+            break;
+        
+        unsigned type = readWord(header);
+        payload.resize(readWord(header + 4));
+        if (!payload.empty() && !recvAll(fd, &payload[0], payload.size()))
+            break;
+        
+        if (type == MSG_DONE)
+        {
+            close(fd);
+            return true;
+        }
+        
+        if (type == MSG_SETTINGS && payload.size() >= 7 * 4)
+        {
+            settings.width = readWord(&payload[0]);
+            settings.height = readWord(&payload[4]);
+            settings.maxDepth = readWord(&payload[8]);
+            settings.orthographic = readWord(&payload[12]) != 0;
+            settings.antialiasFactor = readWord(&payload[16]);
+            settings.samplePattern = (SamplePattern) readWord(&payload[20]);
+            settings.pixelFilter = (PixelFilter) readWord(&payload[24]);
+            haveSettings = true;
+        }
+        else if (type == MSG_TILE && haveSettings && payload.size() >= TILE_FIELDS * 4)
+        {
+            unsigned fields[TILE_FIELDS];
+            for (int i = 0; i < TILE_FIELDS; i++)
+                fields[i] = readWord(&payload[i * 4]);
+            
+            int left = fields[1], top = fields[2], width = fields[3], height = fields[4];
+            pixels.resize((size_t) width * height * 3);
+            
+            // one row of the tile at a time on each core, or with a filter one band of rows,
+            // since each call traces all the lattice samples its filter reaches around its rows
+            int bandHeight = settings.pixelFilter == BOX_FILTER ? 1 : FILTER_BAND_HEIGHT;
+            parallelFor(0, (height + bandHeight - 1) / bandHeight, [&](int band)
+            {
+                int row = band * bandHeight;
+                drawSceneTile(scene, &pixels[(size_t) row * width * 3], settings.width, settings.height,
+                              left, top + row, width, std::min(bandHeight, height - row),
+                              settings.maxDepth, settings.orthographic, settings.antialiasFactor,
+                              settings.samplePattern, settings.pixelFilter);
+            });
+            
+            if (!sendMessage(fd, MSG_RESULT, fields, TILE_FIELDS, &pixels[0], pixels.size()))
+                break;
+        }
+    }
+    
+    close(fd);
+    return false;
+}
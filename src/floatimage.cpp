@@ -0,0 +1,89 @@
+#include <floatimage.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+MappedFloatImage::MappedFloatImage()
+{
+    pixels = NULL;
+    mapping = NULL;
+    mappingSize = 0;
+}
+
+MappedFloatImage::~MappedFloatImage()
+{
+    close();
+}
+
+// builds the PFM header: "PF" for rgb or "Pf" for grayscale, the dimensions and a scale
+// whose sign gives the byte order. the scale is padded with zeros until the header
+// length is a multiple of 4, so the floats after it are aligned.
+static std::string pfmHeader(int width, int height, int channels)
+{
+    unsigned short one = 1;
+    bool littleEndian = *(unsigned char*) &one == 1;
+    
+    char dims[64];
+    snprintf(dims, sizeof(dims), "%s\n%d %d\n", channels == 3 ? "PF" : "Pf", width, height);
+    
+    std::string header = dims;
+    std::string scale = littleEndian ? "-1.0" : "1.0";
+    while ((header.size() + scale.size() + 1) % 4 != 0)
+        scale += "0";
+    
+    return header + scale + "\n";
+}
+
+static bool endsWith(const char* s, const char* suffix)
+{
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+bool MappedFloatImage::create(const char* filename, int width, int height, int channels)
+{
+    close();
+    
+    std::string header;
+    if (endsWith(filename, ".pfm"))
+        header = pfmHeader(width, height, channels);
+    
+    size_t size = header.size() + (size_t) width * height * channels * sizeof(float);
+    
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    
+    if (ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    
+    void* m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    
+    memcpy(m, header.data(), header.size());
+    
+    mapping = m;
+    mappingSize = size;
+    pixels = (float*) ((char*) m + header.size());
+    return true;
+}
+
+void MappedFloatImage::close()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+    
+    pixels = NULL;
+    mapping = NULL;
+    mappingSize = 0;
+}
@@ -0,0 +1,180 @@
+#include <grid.h>
+
+Grid::Grid(Scene* scene, float density)
+{
+    this->scene = scene;
+    
+    vector<Bounds> objectBounds(scene->objects.size());
+    vector<int> bounded;
+    for (size_t i = 0; i < scene->objects.size(); i++)
+    {
+        objectBounds[i] = paddedBounds(scene->objects[i]);
+        if (isUnbounded(objectBounds[i]))
+            unbounded.push_back(i);
+        else
+        {
+            bounded.push_back(i);
+            bounds.add(objectBounds[i]);
+        }
+    }
+    
+    if (bounded.empty())
+    {
+        cells[0] = cells[1] = cells[2] = 0;
+        return;
+    }
+    chooseResolution(bounded.size(), density);
+    
+    // count the objects in each cell, then list them, so each cell's list is in order
+    cellStart.assign((size_t) cells[0] * cells[1] * cells[2] + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < bounded.size(); i++)
+        {
+            const Bounds &b = objectBounds[bounded[i]];
+            int x0 = cellOf(b.min.x, 0), x1 = cellOf(b.max.x, 0);
+            int y0 = cellOf(b.min.y, 1), y1 = cellOf(b.max.y, 1);
+            int z0 = cellOf(b.min.z, 2), z1 = cellOf(b.max.z, 2);
+            for (int z = z0; z <= z1; z++)
+                for (int y = y0; y <= y1; y++)
+                    for (int x = x0; x <= x1; x++)
+                    {
+                        int cell = x + cells[0] * (y + cells[1] * z);
+                        if (pass == 0)
+                            cellStart[cell + 1]++;
+                        else
+                            cellObjects[cellStart[cell]++] = bounded[i];
+                    }
+        }
+        
+        if (pass == 0)
+        {
+            for (size_t i = 1; i < cellStart.size(); i++)
+                cellStart[i] += cellStart[i - 1];
+            cellObjects.resize(cellStart.back());
+        }
+        else
+        {
+            // filling each cell moved its start to the start of the next
+            for (size_t i = cellStart.size() - 1; i > 0; i--)
+                cellStart[i] = cellStart[i - 1];
+            cellStart[0] = 0;
+        }
+    }
+}
+
+void Grid::chooseResolution(int objects, float density)
+{
+    float extent[3] = { bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z };
+    float largest = std::max(extent[0], std::max(extent[1], extent[2]));
+    
+    // cubic cells, as many as density asks for, over the axes the objects spread along,
+    // so objects all in a plane or on a line get a grid in that plane or along that line
+    float volume = 1;
+    int dimensions = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] > largest * 1e-3f)
+        {
+            volume *= extent[axis];
+            dimensions++;
+        }
+    }
+    float cellsPerUnit = dimensions ? powf(density * objects / volume, 1.0f / dimensions) : 0;
+    
+    for (int axis = 0; axis < 3; axis++)
+    {
+        cells[axis] = extent[axis] > largest * 1e-3f ? (int) (extent[axis] * cellsPerUnit + 0.5f) : 1;
+        cells[axis] = std::max(1, std::min(GRID_MAX_RESOLUTION, cells[axis]));
+        cellSize[axis] = extent[axis] > 0 ? extent[axis] / cells[axis] : 1;
+    }
+}
+
+int Grid::cellOf(float x, int axis)
+{
+    float min = axis == 0 ? bounds.min.x : axis == 1 ? bounds.min.y : bounds.min.z;
+    int cell = (int) ((x - min) / cellSize[axis]);
+    return std::max(0, std::min(cells[axis] - 1, cell));
+}
+
+size_t Grid::memoryUsed()
+{
+    return sizeof(Grid) + (cellStart.capacity() + cellObjects.capacity() + unbounded.capacity()) * sizeof(int);
+}
+
+Intersection* Grid::findFirstIntersection(Ray* ray)
+{
+    Intersection* closest = NULL;
+    int closestIndex = 0;
+    
+    for (size_t i = 0; i < unbounded.size(); i++)
+        tryObject(scene, unbounded[i], ray, closest, closestIndex);
+    
+    if (cellStart.empty())
+        return closest;
+    
+    Vector inverse(reciprocal(ray->direction.x), reciprocal(ray->direction.y), reciprocal(ray->direction.z));
+    float start = enterBox(bounds, ray->origin, inverse, closest ? closest->t : INFINITY);
+    if (start == INFINITY)
+        return closest;
+    start = std::max(start, 0.0f);
+    
+    // walk the cells the ray passes through from where it enters the grid, stepping along
+    // whichever axis it next crosses a cell boundary on
+    float origin[3] = { ray->origin.x, ray->origin.y, ray->origin.z };
+    float direction[3] = { ray->direction.x, ray->direction.y, ray->direction.z };
+    float inverses[3] = { inverse.x, inverse.y, inverse.z };
+    float min[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+    int cell[3], step[3], end[3];
+    float next[3], delta[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        cell[axis] = cellOf(origin[axis] + direction[axis] * start, axis);
+        if (direction[axis] > 0)
+        {
+            step[axis] = 1;
+            end[axis] = cells[axis];
+            next[axis] = (min[axis] + (cell[axis] + 1) * cellSize[axis] - origin[axis]) * inverses[axis];
+            delta[axis] = cellSize[axis] * inverses[axis];
+        }
+        else if (direction[axis] < 0)
+        {
+            step[axis] = -1;
+            end[axis] = -1;
+            next[axis] = (min[axis] + cell[axis] * cellSize[axis] - origin[axis]) * inverses[axis];
+            delta[axis] = -cellSize[axis] * inverses[axis];
+        }
+        else
+        {
+            step[axis] = 0;
+            end[axis] = -1;
+            next[axis] = delta[axis] = INFINITY;
+        }
+    }
+    
+    int mailbox[GRID_MAILBOX_SIZE];
+    std::fill(mailbox, mailbox + GRID_MAILBOX_SIZE, -1);
+    while (true)
+    {
+        int index = cell[0] + cells[0] * (cell[1] + cells[1] * cell[2]);
+        for (int i = cellStart[index]; i < cellStart[index + 1]; i++)
+        {
+            int object = cellObjects[i];
+            int &slot = mailbox[object & (GRID_MAILBOX_SIZE - 1)];
+            if (slot == object)
+                continue;
+            slot = object;
+            tryObject(scene, object, ray, closest, closestIndex);
+        }
+        
+        int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        // a hit before the ray leaves this cell is in this cell or one it has been through,
+        // so every object that could tie or beat it has been tried
+        if (closest && closest->t < next[axis])
+            return closest;
+        cell[axis] += step[axis];
+        if (cell[axis] == end[axis])
+            return closest;
+        next[axis] += delta[axis];
+    }
+}
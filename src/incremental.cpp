@@ -0,0 +1,178 @@
+#include <incremental.h>
+#include <parallel.h>
+
+#include <algorithm>
+#include <cmath>
+
+// pixels per side of the blocks a TraceRecorder keeps boxes for
+#define RECORD_BLOCK 4
+
+TraceRecorder::TraceRecorder(int width, int height, int numLights)
+{
+    blocksAcross = (width + RECORD_BLOCK - 1) / RECORD_BLOCK;
+    int blocksDown = (height + RECORD_BLOCK - 1) / RECORD_BLOCK;
+    kinds = SHADOW_RAYS + numLights;
+    block = 0;
+    
+    segments.resize((size_t) blocksAcross * blocksDown * kinds);
+    lights.resize(numLights);
+}
+
+void TraceRecorder::setPixel(int x, int y)
+{
+    block = (y / RECORD_BLOCK) * blocksAcross + x / RECORD_BLOCK;
+}
+
+// the end of a ray segment along one axis, where t may be infinite
+static inline float segmentEnd(float origin, float direction, float t)
+{
+    if (direction == 0)
+        return origin;
+    if (std::isinf(t))
+        return direction > 0 ? INFINITY : -INFINITY;
+    return origin + t * direction;
+}
+
+void TraceRecorder::recordSegment(int kind, Point origin, Vector direction, float t)
+{
+    float endX = segmentEnd(origin.x, direction.x, t);
+    float endY = segmentEnd(origin.y, direction.y, t);
+    float endZ = segmentEnd(origin.z, direction.z, t);
+    Bounds segment(Point(std::min(origin.x, endX), std::min(origin.y, endY), std::min(origin.z, endZ)),
+                   Point(std::max(origin.x, endX), std::max(origin.y, endY), std::max(origin.z, endZ)));
+    
+    // lights added since the recorder was made share the last box, which only makes it bigger
+    segments[(size_t) block * kinds + std::min(kind, kinds - 1)].add(segment);
+}
+
+void TraceRecorder::recordHit(GeometricObject* object)
+{
+    objects.insert(object);
+}
+
+void TraceRecorder::recordLight(int light)
+{
+    if (light >= (int) lights.size())
+        lights.resize(light + 1);
+    lights[light] = true;
+}
+
+bool TraceRecorder::dependsOn(GeometricObject* object)
+{
+    if (objects.count(object))
+        return true;
+    
+    Bounds bounds;
+    object->getBounds(bounds.min, bounds.max);
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (segments[i].overlaps(bounds))
+            return true;
+    }
+    return false;
+}
+
+bool TraceRecorder::dependsOnLight(int light)
+{
+    return light < (int) lights.size() && lights[light];
+}
+
+IncrementalRenderer::IncrementalRenderer(Scene* scene, unsigned char* buffer, int width, int height, int maxDepth,
+                                         bool orthographic, int antialias, SamplePattern pattern, int tileSize)
+{
+    this->scene = scene;
+    this->buffer = buffer;
+    this->width = width;
+    this->height = height;
+    this->maxDepth = maxDepth;
+    this->orthographic = orthographic;
+    this->antialias = antialias;
+    this->pattern = pattern;
+    this->tileSize = tileSize;
+    
+    tilesAcross = (width + tileSize - 1) / tileSize;
+    tilesDown = (height + tileSize - 1) / tileSize;
+    numLights = scene->pointLights.size();
+    
+    recorders.resize(tileCount(), TraceRecorder(0, 0, 0));
+    marked.resize(tileCount(), true);
+}
+
+void IncrementalRenderer::drawTile(int tile)
+{
+    int left = (tile % tilesAcross) * tileSize;
+    int top = (tile / tilesAcross) * tileSize;
+    int tileWidth = std::min(tileSize, width - left);
+    int tileHeight = std::min(tileSize, height - top);
+    int bottom = height - (top + tileHeight);
+    
+    recorders[tile] = TraceRecorder(tileWidth, tileHeight, numLights);
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialias, pattern, &recorders[tile]);
+    
+    for (int row = top; row < top + tileHeight; row++)
+    {
+        // rows count down from the top of the image, y counts up from the bottom of the view plane
+        int y = height - row - 1;
+        
+        for (int x = left; x < left + tileWidth; x++)
+        {
+            recorders[tile].setPixel(x - left, y - bottom);
+            
+            Color c;
+            sampler.drawPixel(x, y, c);
+            quantizePixel(c, buffer + ((size_t) row * width + x) * 3);
+        }
+    }
+}
+
+void IncrementalRenderer::drawAll()
+{
+    std::fill(marked.begin(), marked.end(), true);
+    update();
+}
+
+void IncrementalRenderer::objectChanged(GeometricObject* object)
+{
+    for (int tile = 0; tile < tileCount(); tile++)
+    {
+        if (!marked[tile] && recorders[tile].dependsOn(object))
+            marked[tile] = true;
+    }
+}
+
+void IncrementalRenderer::lightChanged(PointLight* light)
+{
+    vector<PointLight*> &lights = scene->pointLights;
+    int index = std::find(lights.begin(), lights.end(), light) - lights.begin();
+    
+    for (int tile = 0; tile < tileCount(); tile++)
+    {
+        if (index == (int) lights.size() || recorders[tile].dependsOnLight(index))
+            marked[tile] = true;
+    }
+}
+
+int IncrementalRenderer::update()
+{
+    // the light numbers in the recorders are only right for the lights they were made with
+    if ((int) scene->pointLights.size() != numLights)
+    {
+        numLights = scene->pointLights.size();
+        std::fill(marked.begin(), marked.end(), true);
+    }
+    
+    vector<int> tiles;
+    for (int tile = 0; tile < tileCount(); tile++)
+    {
+        if (marked[tile])
+            tiles.push_back(tile);
+    }
+    
+    parallelFor(0, tiles.size(), [&](int i)
+    {
+        drawTile(tiles[i]);
+    });
+    
+    std::fill(marked.begin(), marked.end(), false);
+    return tiles.size();
+}
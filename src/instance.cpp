@@ -0,0 +1,91 @@
+#include <instance.h>
+
+Model::Model(const vector<GeometricObject*> &objects)
+{
+    scene.objects = objects;
+    bvh = new BVH(&scene);
+    
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        Point min, max;
+        objects[i]->getBounds(min, max);
+        bounds.add(Bounds(min, max));
+    }
+}
+
+Model::~Model()
+{
+    delete bvh;
+    for (size_t i = 0; i < scene.objects.size(); i++)
+        delete scene.objects[i];
+}
+
+Intersection* Model::intersect(Ray* ray)
+{
+    return bvh->findFirstIntersection(ray);
+}
+
+void Model::getBounds(Point &min, Point &max)
+{
+    min = bounds.min;
+    max = bounds.max;
+}
+
+// an intersection with an object of a model, where an instance has moved it
+class InstanceIntersection : public Intersection
+{
+    public:
+        // the intersection with the model's object, where the model's origin is
+        Intersection* inModel;
+        
+        virtual void getNormal(Vector &n)
+        {
+            inModel->getNormal(n);
+        }
+        
+        virtual void getMaterial(Material &m)
+        {
+            inModel->getMaterial(m);
+        }
+        
+        virtual ~InstanceIntersection()
+        {
+            delete inModel;
+        }
+};
+
+Instance::Instance(Model* model, Vector offset)
+{
+    this->model = model;
+    this->offset = offset;
+}
+
+Intersection* Instance::intersect(Ray* ray)
+{
+    // the ray moved the other way hits the model where the ray hits the instance
+    Ray inModel(Point(ray->origin.x - offset.x, ray->origin.y - offset.y, ray->origin.z - offset.z),
+                ray->direction);
+    Intersection* hit = model->intersect(&inModel);
+    if (!hit)
+        return NULL;
+    
+    InstanceIntersection* i = new InstanceIntersection;
+    i->inModel = hit;
+    i->t = hit->t;
+    i->point = hit->point + offset;
+    i->object = this;
+    
+    return i;
+}
+
+void Instance::getBounds(Point &min, Point &max)
+{
+    model->getBounds(min, max);
+    min = min + offset;
+    max = max + offset;
+}
+
+void Instance::translate(Vector offset)
+{
+    this->offset = this->offset + offset;
+}
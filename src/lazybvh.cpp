@@ -0,0 +1,101 @@
+#include <lazybvh.h>
+
+#include <thread>
+
+LazyBVH::LazyBVH(Scene* scene)
+{
+    this->scene = scene;
+    
+    objectBounds.resize(scene->objects.size());
+    Bounds bounds;
+    for (size_t i = 0; i < scene->objects.size(); i++)
+    {
+        objectBounds[i] = paddedBounds(scene->objects[i]);
+        if (isUnbounded(objectBounds[i]))
+            unbounded.push_back(i);
+        else
+        {
+            order.push_back(i);
+            bounds.add(objectBounds[i]);
+        }
+    }
+    
+    // a tree with a leaf for each object has the most nodes
+    nodes.reset(new Node[order.empty() ? 1 : 2 * order.size() - 1]);
+    nodeCount = order.empty() ? 0 : 1;
+    if (!order.empty())
+    {
+        initNode(nodes[0], 0, order.size(), 1);
+        nodes[0].bounds = bounds;
+    }
+}
+
+void LazyBVH::initNode(Node &node, int first, int count, int depth)
+{
+    node.first = first;
+    node.count = count;
+    node.depth = depth;
+    node.state.store(UNSPLIT, std::memory_order_relaxed);
+}
+
+int LazyBVH::split(Node &node)
+{
+    int state = node.state.load(std::memory_order_acquire);
+    if (state >= LEAF)
+        return state;
+    
+    state = UNSPLIT;
+    if (!node.state.compare_exchange_strong(state, SPLITTING, std::memory_order_acquire))
+    {
+        // another ray is splitting it
+        while ((state = node.state.load(std::memory_order_acquire)) < LEAF)
+            std::this_thread::yield();
+        return state;
+    }
+    
+    int below = node.depth < BVH_MAX_DEPTH ?
+                partitionObjects(&order[node.first], node.count, objectBounds, node.bounds) : 0;
+    if (below == 0)
+    {
+        node.state.store(LEAF, std::memory_order_release);
+        return LEAF;
+    }
+    
+    int children = nodeCount.fetch_add(2);
+    Node &a = nodes[children], &b = nodes[children + 1];
+    initNode(a, node.first, below, node.depth + 1);
+    initNode(b, node.first + below, node.count - below, node.depth + 1);
+    a.bounds = b.bounds = Bounds();
+    for (int i = a.first; i < a.first + a.count; i++)
+        a.bounds.add(objectBounds[order[i]]);
+    for (int i = b.first; i < b.first + b.count; i++)
+        b.bounds.add(objectBounds[order[i]]);
+    
+    node.children = children;
+    node.state.store(BRANCH, std::memory_order_release);
+    return BRANCH;
+}
+
+Intersection* LazyBVH::findFirstIntersection(Ray* ray)
+{
+    Intersection* closest = NULL;
+    int closestIndex = 0;
+    
+    for (size_t i = 0; i < unbounded.size(); i++)
+        tryObject(scene, unbounded[i], ray, closest, closestIndex);
+    
+    if (order.empty())
+        return closest;
+    
+    // nodes are split the first time a ray gets to them
+    findInTree(scene, ray, nodes.get(), &order[0], [&](int node, int &a, int &b)
+    {
+        Node &n = nodes[node];
+        if (split(n) == LEAF)
+            return false;
+        a = n.children;
+        b = n.children + 1;
+        return true;
+    }, closest, closestIndex);
+    return closest;
+}
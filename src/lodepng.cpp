@@ -32,6 +32,7 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef LODEPNG_COMPILE_CPP
 #include <fstream>
@@ -438,6 +439,26 @@ static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bits
   }
   return result;
 }
+
+/*
+returns a 64-bit buffer with the bits of the stream starting at bitpointer, the next bit in
+the lsb. At least 57 bits are valid; bits past the end of the input (inlength bytes) read as 0.
+*/
+static inline unsigned long long peekBits(const unsigned char* bitstream, size_t inlength, size_t bitpointer)
+{
+  size_t start = bitpointer >> 3, i;
+  unsigned long long result = 0;
+  if(start + 8 <= inlength)
+  {
+    /*compilers turn this into a single unaligned load on little endian machines*/
+    for(i = 0; i < 8; i++) result |= (unsigned long long)bitstream[start + i] << (8 * i);
+  }
+  else
+  {
+    for(i = 0; start + i < inlength; i++) result |= (unsigned long long)bitstream[start + i] << (8 * i);
+  }
+  return result >> (bitpointer & 0x7);
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -485,7 +506,8 @@ Huffman tree struct, containing multiple representations of the tree
 */
 typedef struct HuffmanTree
 {
-  unsigned* tree2d;
+  unsigned short* table_len; /*decoder lookup table: code length of the entry, or 0 for invalid codes*/
+  unsigned short* table_value; /*decoder lookup table: the symbol, or the start of a second level table*/
   unsigned* tree1d;
   unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
   unsigned maxbitlen; /*maximum number of bits a single code can get*/
@@ -507,73 +529,120 @@ static void HuffmanTree_draw(HuffmanTree* tree)
 
 static void HuffmanTree_init(HuffmanTree* tree)
 {
-  tree->tree2d = 0;
+  tree->table_len = 0;
+  tree->table_value = 0;
   tree->tree1d = 0;
   tree->lengths = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
 {
-  lodepng_free(tree->tree2d);
+  lodepng_free(tree->table_len);
+  lodepng_free(tree->table_value);
   lodepng_free(tree->tree1d);
   lodepng_free(tree->lengths);
 }
 
-/*the tree representation used by the decoder. return value is error*/
-static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
+/*number of bits the first level of the decoder lookup table is indexed with*/
+#define FIRSTBITS 9u
+
+static unsigned reverseBits(unsigned bits, unsigned num)
 {
-  unsigned nodefilled = 0; /*up to which node it is filled*/
-  unsigned treepos = 0; /*position in the tree (1 of the numcodes columns)*/
-  unsigned n, i;
+  unsigned i, result = 0;
+  for(i = 0; i < num; i++) result |= ((bits >> (num - i - 1)) & 1u) << i;
+  return result;
+}
 
-  tree->tree2d = (unsigned*)lodepng_malloc(tree->numcodes * 2 * sizeof(unsigned));
-  if(!tree->tree2d) return 83; /*alloc fail*/
+/*
+the lookup table representation used by the decoder. return value is error.
+The first level has 2^FIRSTBITS entries indexed with the next FIRSTBITS bits of the
+stream (the first bit of the code in the lsb). Codes of at most FIRSTBITS bits fill
+all entries that start with them. Longer codes share a second level table per
+FIRSTBITS-bit prefix, sized for the longest code with that prefix; the first level
+entry then holds that maximum length and the offset of the second level table.
+*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+  static const unsigned headsize = 1u << FIRSTBITS;
+  static const unsigned mask = (1u << FIRSTBITS) - 1u;
+  unsigned maxlens[1u << FIRSTBITS];
+  unsigned long kraft = 0;
+  size_t i, size, pointer;
 
   /*
-  convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means
-  uninited, a value >= numcodes is an address to another bit, a value < numcodes
-  is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as
-  many columns as codes - 1.
-  A good huffmann tree has N * 2 - 1 nodes, of which N - 1 are internal nodes.
-  Here, the internal nodes are stored (what their 0 and 1 option point to).
-  There is only memory for such good tree currently, if there are more nodes
-  (due to too long length codes), error 55 will happen
+  an oversubscribed set of lengths can't be a prefix code (and would overflow the second
+  level tables), see comment in lodepng_error_text. Incomplete sets are allowed: the
+  unused entries stay 0 and decoding them is an error.
   */
-  for(n = 0; n < tree->numcodes * 2; n++)
+  for(i = 0; i < tree->numcodes; i++)
   {
-    tree->tree2d[n] = 32767; /*32767 here means the tree2d isn't filled there yet*/
+    if(tree->lengths[i] > 15) return 55;
+    if(tree->lengths[i]) kraft += 1ul << (15 - tree->lengths[i]);
   }
+  if(kraft > (1ul << 15)) return 55;
 
-  for(n = 0; n < tree->numcodes; n++) /*the codes*/
+  /*compute the longest code of each first level entry, to know the size of its second level table*/
+  for(i = 0; i < headsize; i++) maxlens[i] = 0;
+  for(i = 0; i < tree->numcodes; i++)
   {
-    for(i = 0; i < tree->lengths[n]; i++) /*the bits for this code*/
+    unsigned l = tree->lengths[i];
+    unsigned index;
+    if(l <= FIRSTBITS) continue;
+    index = reverseBits(tree->tree1d[i] >> (l - FIRSTBITS), FIRSTBITS);
+    if(l > maxlens[index]) maxlens[index] = l;
+  }
+
+  size = headsize;
+  for(i = 0; i < headsize; i++)
+  {
+    if(maxlens[i] > FIRSTBITS) size += 1u << (maxlens[i] - FIRSTBITS);
+  }
+
+  tree->table_len = (unsigned short*)lodepng_malloc(size * sizeof(unsigned short));
+  tree->table_value = (unsigned short*)lodepng_malloc(size * sizeof(unsigned short));
+  if(!tree->table_len || !tree->table_value) return 83; /*alloc fail*/
+  for(i = 0; i < size; i++) tree->table_len[i] = tree->table_value[i] = 0;
+
+  /*point the first level entries of long codes to their second level tables*/
+  pointer = headsize;
+  for(i = 0; i < headsize; i++)
+  {
+    if(maxlens[i] <= FIRSTBITS) continue;
+    tree->table_len[i] = (unsigned short)maxlens[i];
+    tree->table_value[i] = (unsigned short)pointer;
+    pointer += 1u << (maxlens[i] - FIRSTBITS);
+  }
+
+  /*fill in every entry whose index starts with the (reversed) code*/
+  for(i = 0; i < tree->numcodes; i++)
+  {
+    unsigned l = tree->lengths[i];
+    unsigned reverse, j, num;
+    if(l == 0) continue;
+    reverse = reverseBits(tree->tree1d[i], l);
+    if(l <= FIRSTBITS)
     {
-      unsigned char bit = (unsigned char)((tree->tree1d[n] >> (tree->lengths[n] - i - 1)) & 1);
-      if(treepos > tree->numcodes - 2) return 55; /*oversubscribed, see comment in lodepng_error_text*/
-      if(tree->tree2d[2 * treepos + bit] == 32767) /*not yet filled in*/
+      num = 1u << (FIRSTBITS - l);
+      for(j = 0; j < num; j++)
       {
-        if(i + 1 == tree->lengths[n]) /*last bit*/
-        {
-          tree->tree2d[2 * treepos + bit] = n; /*put the current code in it*/
-          treepos = 0;
-        }
-        else
-        {
-          /*put address of the next step in here, first that address has to be found of course
-          (it's just nodefilled + 1)...*/
-          nodefilled++;
-          /*addresses encoded with numcodes added to it*/
-          tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;
-          treepos = nodefilled;
-        }
+        unsigned index = reverse | (j << l);
+        tree->table_len[index] = (unsigned short)l;
+        tree->table_value[index] = (unsigned short)i;
+      }
+    }
+    else
+    {
+      unsigned index = reverse & mask;
+      unsigned tablebits = tree->table_len[index] - FIRSTBITS;
+      unsigned start = tree->table_value[index];
+      num = 1u << (tablebits - (l - FIRSTBITS));
+      for(j = 0; j < num; j++)
+      {
+        unsigned index2 = start + ((reverse >> FIRSTBITS) | (j << (l - FIRSTBITS)));
+        tree->table_len[index2] = (unsigned short)l;
+        tree->table_value[index2] = (unsigned short)i;
       }
-      else treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
     }
-  }
-
-  for(n = 0; n < tree->numcodes * 2; n++)
-  {
-    if(tree->tree2d[n] == 32767) tree->tree2d[n] = 0; /*remove possible remaining 32767's*/
   }
 
   return 0;
@@ -619,7 +688,7 @@ static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree)
   uivector_cleanup(&blcount);
   uivector_cleanup(&nextcode);
 
-  if(!error) return HuffmanTree_make2DTree(tree);
+  if(!error) return HuffmanTree_makeTable(tree);
   else return error;
 }
 
@@ -895,6 +964,25 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/*
+decodes the symbol at the start of bits (the first bit of the code in the lsb) with at most two
+table lookups. Returns the symbol and sets len to the length of its code, or returns
+(unsigned)(-1) and sets len to 0 if the bits are not a code of the tree
+*/
+static unsigned huffmanDecodeBits(unsigned long long bits, const HuffmanTree* codetree, unsigned* len)
+{
+  unsigned index = (unsigned)bits & ((1u << FIRSTBITS) - 1u);
+  unsigned l = codetree->table_len[index];
+  if(l > FIRSTBITS)
+  {
+    /*long code, look up the remaining bits in the second level table*/
+    index = codetree->table_value[index] + ((unsigned)(bits >> FIRSTBITS) & ((1u << (l - FIRSTBITS)) - 1u));
+    l = codetree->table_len[index];
+  }
+  *len = l;
+  return l ? codetree->table_value[index] : (unsigned)(-1);
+}
+
 /*
 returns the code, or (unsigned)(-1) if error happened
 inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
@@ -902,21 +990,12 @@ inbitlength is the length of the complete buffer, in bits (so its byte length ti
 static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
                                     const HuffmanTree* codetree, size_t inbitlength)
 {
-  unsigned treepos = 0, ct;
-  for(;;)
-  {
-    if(*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
-    /*
-    decode the symbol from the tree. The "readBitFromStream" code is inlined in
-    the expression below because this is the biggest bottleneck while decoding
-    */
-    ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-    (*bp)++;
-    if(ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
-    else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
-
-    if(treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
-  }
+  unsigned code, len;
+  if(*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+  code = huffmanDecodeBits(peekBits(in, inbitlength >> 3, *bp), codetree, &len);
+  (*bp) += len;
+  if(*bp > inbitlength) return (unsigned)(-1); /*error: the code runs past the end of the input*/
+  return code;
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -1099,8 +1178,21 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
+    /*
+    a literal/length code, its extra bits, a distance code and its extra bits take at most
+    15 + 5 + 15 + 13 = 48 bits, so one peek holds everything needed for the next symbol
+    */
+    unsigned long long bits;
+    unsigned code_ll, len;
+
+    if(*bp >= inbitlength) ERROR_BREAK(10); /*error: end of input memory reached without endcode*/
+    bits = peekBits(in, inlength, *bp);
+
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    code_ll = huffmanDecodeBits(bits, &tree_ll, &len);
+    bits >>= len;
+    (*bp) += len;
+
     if(code_ll <= 255) /*literal symbol*/
     {
       if((*pos) >= out->size)
@@ -1115,25 +1207,29 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     {
       unsigned code_d, distance;
       unsigned numextrabits_l, numextrabits_d; /*extra bits for length and distance*/
-      size_t start, forward, backward, length;
+      size_t forward, length;
+      unsigned char* data;
 
       /*part 1: get length base*/
       length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
 
       /*part 2: get extra bits and add the value of that to length*/
       numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-      if(*bp >= inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      length += readBitsFromStream(bp, in, numextrabits_l);
+      length += (size_t)(bits & ((1u << numextrabits_l) - 1u));
+      bits >>= numextrabits_l;
+      (*bp) += numextrabits_l;
 
       /*part 3: get distance code*/
-      code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
+      code_d = huffmanDecodeBits(bits, &tree_d, &len);
+      bits >>= len;
+      (*bp) += len;
       if(code_d > 29)
       {
-        if(code_ll == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
+        if(code_d == (unsigned)(-1)) /*huffmanDecodeBits returns (unsigned)(-1) in case of error*/
         {
-          /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
+          /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeBits
           (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inlength * 8 ? 10 : 11;
+          error = (*bp) > inbitlength ? 10 : 11;
         }
         else error = 18; /*error: invalid distance code (30-31 are never used)*/
         break;
@@ -1142,37 +1238,38 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
       /*part 4: get extra bits from distance*/
       numextrabits_d = DISTANCEEXTRA[code_d];
-      if(*bp >= inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-
-      distance += readBitsFromStream(bp, in, numextrabits_d);
+      distance += (unsigned)(bits & ((1u << numextrabits_d) - 1u));
+      (*bp) += numextrabits_d;
+      if(*bp > inbitlength) ERROR_BREAK(51); /*error, bit pointer jumped past memory*/
 
       /*part 5: fill in all the out[n] values based on the length and dist*/
-      start = (*pos);
-      if(distance > start) ERROR_BREAK(52); /*too long backward distance*/
-      backward = start - distance;
+      if(distance > (*pos)) ERROR_BREAK(52); /*too long backward distance*/
       if((*pos) + length >= out->size)
       {
         /*reserve more room at once*/
         if(!ucvector_resize(out, ((*pos) + length) * 2)) ERROR_BREAK(83 /*alloc fail*/);
       }
 
-      for(forward = 0; forward < length; forward++)
+      data = out->data + (*pos);
+      if(distance >= length) memcpy(data, data - distance, length);
+      else if(distance == 1) memset(data, data[-1], length); /*run of a single byte*/
+      else
       {
-        out->data[(*pos)] = out->data[backward];
-        (*pos)++;
-        backward++;
-        if(backward >= start) backward = start - distance;
+        /*copying forwards byte by byte also handles overlapping runs (distance < length)*/
+        for(forward = 0; forward < length; forward++) data[forward] = data[forward - distance];
       }
+      (*pos) += length;
     }
     else if(code_ll == 256)
     {
+      if(*bp > inbitlength) ERROR_BREAK(10); /*error: the end code runs past the end of the input*/
       break; /*end code, break the loop*/
     }
-    else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
+    else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeBits returns (unsigned)(-1) in case of error*/
     {
-      /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
+      /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeBits
       (10=no endcode, 11=wrong jump outside of tree)*/
-      error = (*bp) > inlength * 8 ? 10 : 11;
+      error = (*bp) > inbitlength ? 10 : 11;
       break;
     }
   }
@@ -1597,7 +1694,7 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, int final)
 {
   /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
   2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
@@ -1609,7 +1706,7 @@ static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, s
     unsigned BFINAL, BTYPE, LEN, NLEN;
     unsigned char firstbyte;
 
-    BFINAL = (i == numdeflateblocks - 1);
+    BFINAL = final && (i == numdeflateblocks - 1);
     BTYPE = 0;
 
     firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
@@ -1961,8 +2058,13 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
+/*
+if final is 0, no block is marked as the last one and the output ends with an empty
+non-compressed block, which pads it to a whole byte (like zlib's Z_SYNC_FLUSH). Such outputs
+can be concatenated to form one deflate stream, as long as the last part is final.
+*/
 static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+                                 const LodePNGCompressSettings* settings, int final)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
@@ -1970,7 +2072,7 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   Hash hash;
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
+  else if(settings->btype == 0) return deflateNoCompression(out, in, insize, final);
   else if(settings->btype == 1) blocksize = insize;
   else /*if(settings->btype == 2)*/
   {
@@ -1986,17 +2088,27 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   for(i = 0; i < numdeflateblocks && !error; i++)
   {
-    int final = i == numdeflateblocks - 1;
+    int lastblock = final && i == numdeflateblocks - 1;
     size_t start = i * blocksize;
     size_t end = start + blocksize;
     if(end > insize) end = insize;
 
-    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
-    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, lastblock);
+    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, lastblock);
   }
 
   hash_cleanup(&hash);
 
+  if(!error && !final)
+  {
+    /*empty non-compressed block: BFINAL 0 and BTYPE 00, then from the next byte LEN 0 and NLEN 65535*/
+    addBitsToStream(&bp, out, 0, 3);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 255);
+    ucvector_push_back(out, 255);
+  }
+
   return error;
 }
 
@@ -2007,7 +2119,20 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
   unsigned error;
   ucvector v;
   ucvector_init_buffer(&v, *out, *outsize);
-  error = lodepng_deflatev(&v, in, insize, settings);
+  error = lodepng_deflatev(&v, in, insize, settings, 1);
+  *out = v.data;
+  *outsize = v.size;
+  return error;
+}
+
+unsigned lodepng_deflate_flush(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t insize,
+                               const LodePNGCompressSettings* settings)
+{
+  unsigned error;
+  ucvector v;
+  ucvector_init_buffer(&v, *out, *outsize);
+  error = lodepng_deflatev(&v, in, insize, settings, 0);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -2056,6 +2181,19 @@ static unsigned update_adler32(unsigned adler, const unsigned char* data, unsign
   return (s2 << 16) | s1;
 }
 
+unsigned lodepng_update_adler32(unsigned adler, const unsigned char* data, size_t len)
+{
+  /*update_adler32 takes an unsigned length, so feed it in 1GB pieces*/
+  while(len > 0)
+  {
+    unsigned amount = len > 1073741824u ? 1073741824u : (unsigned)len;
+    adler = update_adler32(adler, data, amount);
+    data += amount;
+    len -= amount;
+  }
+  return adler;
+}
+
 /*Return the adler32 of the bytes data[0..len-1]*/
 static unsigned adler32(const unsigned char* data, unsigned len)
 {
@@ -0,0 +1,169 @@
+#include <net.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// fills in a Unix domain socket address and returns true if address is one
+static bool unixAddress(const char* address, struct sockaddr_un &addr)
+{
+    const char* path;
+    if (strncmp(address, "unix:", 5) == 0)
+        path = address + 5;
+    else if (strchr(address, '/'))
+        path = address;
+    else
+        return false;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+// resolves a "host:port" address. returns NULL on failure; free the result with freeaddrinfo.
+static struct addrinfo* tcpAddress(const char* address, bool passive)
+{
+    const char* colon = strrchr(address, ':');
+    if (!colon)
+        return NULL;
+    
+    std::string host(address, colon - address);
+    std::string port(colon + 1);
+    
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive)
+        hints.ai_flags = AI_PASSIVE;
+    
+    bool anyHost = host.empty() || host == "*";
+    struct addrinfo* result;
+    if (getaddrinfo(anyHost ? NULL : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return NULL;
+    return result;
+}
+
+int listenOn(const char* address)
+{
+    struct sockaddr_un un;
+    if (unixAddress(address, un))
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        
+        // a socket file left behind by an earlier run would make bind fail
+        unlink(un.sun_path);
+        if (bind(fd, (struct sockaddr*) &un, sizeof(un)) != 0 || listen(fd, 64) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    
+    struct addrinfo* info = tcpAddress(address, true);
+    if (!info)
+        return -1;
+    
+    int fd = -1;
+    for (struct addrinfo* ai = info; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 64) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    
+    freeaddrinfo(info);
+    return fd;
+}
+
+int connectTo(const char* address)
+{
+    struct sockaddr_un un;
+    if (unixAddress(address, un))
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        
+        if (connect(fd, (struct sockaddr*) &un, sizeof(un)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    
+    struct addrinfo* info = tcpAddress(address, false);
+    if (!info)
+        return -1;
+    
+    int fd = -1;
+    for (struct addrinfo* ai = info; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    
+    freeaddrinfo(info);
+    return fd;
+}
+
+void unlinkAddress(const char* address)
+{
+    struct sockaddr_un un;
+    if (unixAddress(address, un))
+        unlink(un.sun_path);
+}
+
+bool sendAll(int fd, const void* data, size_t length)
+{
+    const char* p = (const char*) data;
+    while (length > 0)
+    {
+        // MSG_NOSIGNAL, so a peer that went away is an error rather than SIGPIPE
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool recvAll(int fd, void* data, size_t length)
+{
+    char* p = (char*) data;
+    while (length > 0)
+    {
+        ssize_t n = recv(fd, p, length, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#include <parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int threadCount()
+{
+    int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+void parallelFor(int begin, int end, const std::function<void(int)> &body)
+{
+    std::atomic<int> next(begin);
+    
+    auto work = [&]()
+    {
+        for (int i = next++; i < end; i = next++)
+            body(i);
+    };
+    
+    int extraThreads = std::min(threadCount(), end - begin) - 1;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < extraThreads; t++)
+        threads.push_back(std::thread(work));
+    
+    // the calling thread helps too
+    work();
+    
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
@@ -0,0 +1,192 @@
+#include <pngstream.h>
+#include <lodepng.h>
+
+#include <cstdlib>
+#include <cstring>
+
+// the bytes every PNG file starts with
+static const unsigned char PNG_SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+static void write32(unsigned char* out, unsigned value)
+{
+    out[0] = (value >> 24) & 255;
+    out[1] = (value >> 16) & 255;
+    out[2] = (value >>  8) & 255;
+    out[3] = (value >>  0) & 255;
+}
+
+static unsigned char paeth(short a, short b, short c)
+{
+    short pa = abs(b - c);
+    short pb = abs(a - c);
+    short pc = abs(a + b - c - c);
+    
+    if (pc < pa && pc < pb) return (unsigned char) c;
+    else if (pb < pa) return (unsigned char) b;
+    else return (unsigned char) a;
+}
+
+// applies PNG filter type 0-4 to a row of rgb pixels. prev is the row above (all
+// zeros for the first row of the image). out gets the filtered bytes, without the type byte.
+static void filterRow(unsigned char* out, const unsigned char* row, const unsigned char* prev,
+                      size_t length, int type)
+{
+    const size_t bpp = 3;
+    size_t i;
+    
+    switch (type)
+    {
+        case 0:
+            memcpy(out, row, length);
+            break;
+        case 1:
+            for (i = 0; i < bpp; i++) out[i] = row[i];
+            for (i = bpp; i < length; i++) out[i] = row[i] - row[i - bpp];
+            break;
+        case 2:
+            for (i = 0; i < length; i++) out[i] = row[i] - prev[i];
+            break;
+        case 3:
+            for (i = 0; i < bpp; i++) out[i] = row[i] - (prev[i] >> 1);
+            for (i = bpp; i < length; i++) out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+            break;
+        case 4:
+            for (i = 0; i < bpp; i++) out[i] = row[i] - paeth(0, prev[i], 0);
+            for (i = bpp; i < length; i++) out[i] = row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]);
+            break;
+    }
+}
+
+PNGStreamWriter::PNGStreamWriter()
+{
+    file = NULL;
+    width = height = rowsWritten = 0;
+    adler = 1;
+}
+
+PNGStreamWriter::~PNGStreamWriter()
+{
+    if (file) fclose(file);
+}
+
+unsigned PNGStreamWriter::open(const char* filename, unsigned width, unsigned height)
+{
+    if (width == 0 || height == 0) return 84; // image too small
+    
+    this->width = width;
+    this->height = height;
+    rowsWritten = 0;
+    adler = 1;
+    previousRow.assign(width * 3, 0);
+    
+    file = fopen(filename, "wb");
+    if (!file) return 79; // failed to open file for writing
+    
+    if (fwrite(PNG_SIGNATURE, 1, 8, file) != 8) return 79;
+    
+    // 8 bit rgb, deflate compression, adaptive filtering, no interlacing
+    unsigned char header[13];
+    write32(header + 0, width);
+    write32(header + 4, height);
+    header[8] = 8;
+    header[9] = 2;
+    header[10] = header[11] = header[12] = 0;
+    
+    unsigned error = writeChunk("IHDR", header, 13);
+    if (error) return error;
+    
+    // zlib header for deflate with a 32k window and the default compression level
+    const unsigned char zlibHeader[2] = {0x78, 0x9c};
+    return writeChunk("IDAT", zlibHeader, 2);
+}
+
+unsigned PNGStreamWriter::writeRows(const unsigned char* rows, unsigned numRows)
+{
+    if (!file) return 79;
+    if (numRows > height - rowsWritten) return 84; // more rows than the image has
+    if (numRows == 0) return 0;
+    
+    size_t rowLength = width * 3;
+    filtered.resize(numRows * (rowLength + 1));
+    
+    vector<unsigned char> candidate(rowLength);
+    
+    for (unsigned r = 0; r < numRows; r++)
+    {
+        const unsigned char* row = rows + r * rowLength;
+        const unsigned char* prev = (r == 0) ? &previousRow[0] : row - rowLength;
+        unsigned char* out = &filtered[r * (rowLength + 1)];
+        
+        // pick the filter with the minimum sum of absolute (signed) values,
+        // the same heuristic lodepng uses for truecolor images
+        size_t bestSum = 0;
+        for (int type = 0; type < 5; type++)
+        {
+            filterRow(&candidate[0], row, prev, rowLength, type);
+            
+            size_t sum = 0;
+            for (size_t i = 0; i < rowLength; i++)
+                sum += (candidate[i] < 128) ? candidate[i] : (255 - candidate[i] + 1);
+            
+            if (type == 0 || sum < bestSum)
+            {
+                bestSum = sum;
+                out[0] = (unsigned char) type;
+                memcpy(out + 1, &candidate[0], rowLength);
+            }
+        }
+    }
+    
+    memcpy(&previousRow[0], rows + (numRows - 1) * rowLength, rowLength);
+    rowsWritten += numRows;
+    adler = lodepng_update_adler32(adler, &filtered[0], filtered.size());
+    
+    unsigned char* compressed = NULL;
+    size_t compressedSize = 0;
+    unsigned error = lodepng_deflate_flush(&compressed, &compressedSize, &filtered[0], filtered.size(),
+                                           &lodepng_default_compress_settings);
+    if (!error)
+        error = writeChunk("IDAT", compressed, compressedSize);
+    
+    free(compressed);
+    return error;
+}
+
+unsigned PNGStreamWriter::close()
+{
+    if (!file) return 79;
+    if (rowsWritten != height) return 84; // not all rows were written
+    
+    // an empty final block with fixed huffman codes ends the deflate stream,
+    // followed by the zlib checksum
+    unsigned char trailer[6] = {0x03, 0x00};
+    write32(trailer + 2, adler);
+    
+    unsigned error = writeChunk("IDAT", trailer, 6);
+    if (!error)
+        error = writeChunk("IEND", NULL, 0);
+    
+    if (fclose(file) != 0 && !error) error = 79;
+    file = NULL;
+    return error;
+}
+
+unsigned PNGStreamWriter::writeChunk(const char* type, const unsigned char* data, size_t length)
+{
+    if (length > 2147483647) return 77; // chunk too large
+    
+    // the crc covers the type and the data
+    unsigned char header[8];
+    write32(header, (unsigned) length);
+    memcpy(header + 4, type, 4);
+    
+    vector<unsigned char> crcData(header + 4, header + 8);
+    if (length) crcData.insert(crcData.end(), data, data + length);
+    unsigned char crc[4];
+    write32(crc, lodepng_crc32(&crcData[0], crcData.size()));
+    
+    if (fwrite(header, 1, 8, file) != 8) return 79;
+    if (length && fwrite(data, 1, length, file) != length) return 79;
+    if (fwrite(crc, 1, 4, file) != 4) return 79;
+    return 0;
+}
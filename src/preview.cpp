@@ -0,0 +1,132 @@
+#include <preview.h>
+#include <parallel.h>
+
+#include <atomic>
+#include <cmath>
+
+// the depth difference, relative to the depth, at which a neighbour's weight drops to 1/e
+#define DEPTH_TOLERANCE 0.02f
+// normals are compared by dot(n, m)^NORMAL_POWER
+#define NORMAL_POWER 8
+// below this total weight a missing pixel counts as having no neighbour on its surface
+#define MIN_WEIGHT 1e-3f
+
+// whether mode traces the pixel in column x, y rows from the bottom
+static inline bool isTraced(PreviewMode mode, int x, int y)
+{
+    if (mode == HALF_RESOLUTION)
+        return x % 2 == 0 && y % 2 == 0;
+    if (mode == CHECKERBOARD)
+        return (x + y) % 2 == 0;
+    return true;
+}
+
+// how much the color of a traced pixel with hit q counts toward a missing pixel with hit p
+static float neighbourWeight(const PrimaryHit &p, const PrimaryHit &q)
+{
+    if (p.object != q.object)
+        return 0;
+    
+    // the background has nothing more to compare
+    if (!p.object)
+        return 1;
+    
+    float cosine = p.normal.x * q.normal.x + p.normal.y * q.normal.y + p.normal.z * q.normal.z;
+    if (cosine <= 0)
+        return 0;
+    for (int i = 1; i < NORMAL_POWER; i *= 2)
+        cosine *= cosine;
+    
+    return cosine * expf(-fabsf(p.t - q.t) / (DEPTH_TOLERANCE * p.t + 1e-4f));
+}
+
+int drawScenePreview(Scene* scene, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic,
+                     int antialias, PreviewMode mode, SamplePattern pattern)
+{
+    if (mode == FULL_RESOLUTION)
+    {
+        parallelFor(0, height, [&](int row)
+        {
+            drawSceneRows(scene, buffer + (size_t) row * width * 3, width, height, row, 1, maxDepth, orthographic,
+                          antialias, pattern);
+        });
+        return width * height;
+    }
+    
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialias, pattern);
+    
+    // colors and hits are stored bottom row first, as the view plane is traversed
+    size_t pixels = (size_t) width * height;
+    vector<float> colors(pixels * 3);
+    vector<PrimaryHit> hits(pixels);
+    std::atomic<int> traced(0);
+    
+    // trace the pixels mode picks, and find what the others hit
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t p = (size_t) y * width + x;
+            if (!isTraced(mode, x, y))
+            {
+                sampler.findPrimaryHit(x, y, hits[p]);
+                continue;
+            }
+            
+            Color c;
+            sampler.drawPixel(x, y, c, &hits[p]);
+            colors[p * 3 + 0] = c.r;
+            colors[p * 3 + 1] = c.g;
+            colors[p * 3 + 2] = c.b;
+            traced++;
+        }
+    });
+    
+    // fill in the others. they only read traced pixels, which don't change any more
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (isTraced(mode, x, y))
+                continue;
+            
+            size_t p = (size_t) y * width + x;
+            float sum[3] = {0, 0, 0};
+            float weightSum = 0;
+            
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    int qx = x + dx, qy = y + dy;
+                    if (qx < 0 || qx >= width || qy < 0 || qy >= height || !isTraced(mode, qx, qy))
+                        continue;
+                    
+                    // diagonal neighbours are further away
+                    size_t q = (size_t) qy * width + qx;
+                    float weight = neighbourWeight(hits[p], hits[q]) * (dx && dy ? 0.5f : 1.0f);
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += weight * colors[q * 3 + c];
+                    weightSum += weight;
+                }
+            }
+            
+            if (weightSum < MIN_WEIGHT)
+            {
+                Color c;
+                sampler.drawPixel(x, y, c);
+                colors[p * 3 + 0] = c.r;
+                colors[p * 3 + 1] = c.g;
+                colors[p * 3 + 2] = c.b;
+                traced++;
+                continue;
+            }
+            
+            for (int c = 0; c < 3; c++)
+                colors[p * 3 + c] = sum[c] / weightSum;
+        }
+    });
+    
+    quantizeHDR(&colors[0], buffer, width, height);
+    return traced;
+}
@@ -4,6 +4,9 @@
 #include <cmath>
 #include <iostream>
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
 
 float Vector::normSq()
 {
@@ -150,8 +153,42 @@ Color operator+(Color lhs, Color rhs)
                  lhs.b + rhs.b);
 }
 
+Texture makeTexture(const unsigned char* rgb, int width, int height)
+{
+    Color* image = new Color[width * height];
+    
+    // texture rows count up from the bottom, but decoded pngs start at the top
+    for (int row = 0; row < height; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            int imgIdx = (row * width + col);
+            int bufIdx = ((height - row - 1) * width + col) * 3;
+            image[imgIdx].r = rgb[bufIdx + 0] / 255.0;
+            image[imgIdx].g = rgb[bufIdx + 1] / 255.0;
+            image[imgIdx].b = rgb[bufIdx + 2] / 255.0;
+        }
+    }
+    
+    Texture tex;
+    tex.pixels = image;
+    tex.width = width;
+    tex.height = height;
+    return tex;
+}
+
+// textures that have been loaded before, by file name. textures are never freed,
+// so scenes built later can share the decoded pixels.
+static std::map<std::string, Texture> textureCache;
+static std::mutex textureCacheMutex;
+
 Texture loadTexture(const char* filename)
 {
+    std::lock_guard<std::mutex> lock(textureCacheMutex);
+    std::map<std::string, Texture>::iterator cached = textureCache.find(filename);
+    if (cached != textureCache.end())
+        return cached->second;
+    
     unsigned char* buffer;
     unsigned width, height;
     
@@ -162,29 +199,10 @@ Texture loadTexture(const char* filename)
         exit(1);
     }
     
-    Color* image = new Color[width * height];
-    
-    // lodepng actually loads the image upside down.
-    // they say they don't. but they do.
-    for (unsigned row = 0; row < height; row++)
-    {
-        for (unsigned col = 0; col < width; col++)
-        {
-            unsigned imgIdx = (row * width + col);
-            unsigned bufIdx = ((height - row - 1) * width + col) * 3;
-            image[imgIdx].r = buffer[bufIdx + 0] / 255.0;
-            image[imgIdx].g = buffer[bufIdx + 1] / 255.0;
-            image[imgIdx].b = buffer[bufIdx + 2] / 255.0;
-        }
-    }
-    
+    Texture tex = makeTexture(buffer, width, height);
     free(buffer);
     
-    Texture tex;
-    tex.pixels = image;
-    tex.width = width;
-    tex.height = height;
-    
+    textureCache[filename] = tex;
     return tex;
 }
 
@@ -0,0 +1,209 @@
+#include <progressive.h>
+#include <parallel.h>
+#include <util.h>
+
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// lock free, so setting it from a signal handler is fine
+static std::atomic<bool> stopRequested(false);
+
+void stopProgressiveRender()
+{
+    stopRequested = true;
+}
+
+// passes of one ray per block of this many pixels square, before the antialiasing passes
+static const int COARSE_BLOCKS[] = {4, 2, 1};
+static const int NUM_COARSE_PASSES = 3;
+
+ProgressiveRenderer::ProgressiveRenderer(Scene* scene, int width, int height, int maxDepth, bool orthographic,
+                                         int antialias, SamplePattern pattern)
+    : sampler(scene, width, height, maxDepth, orthographic, antialias, pattern)
+{
+    this->width = width;
+    this->height = height;
+    sums.assign((size_t) width * height, Color(0,0,0));
+    counts.assign((size_t) width * height, 0);
+    image.resize((size_t) width * height * 3);
+    outOfTime = false;
+}
+
+int ProgressiveRenderer::passCount()
+{
+    // the coarse passes take care of the first sample
+    return NUM_COARSE_PASSES + sampler.samplesPerPixel() - 1;
+}
+
+bool ProgressiveRenderer::shouldStop(double deadline)
+{
+    if (deadline > 0 && now() >= deadline)
+        outOfTime = true;
+    return stopRequested || outOfTime;
+}
+
+void ProgressiveRenderer::coarsePass(int blockSize, double deadline)
+{
+    int blockRows = (height + blockSize - 1) / blockSize;
+    
+    parallelFor(0, blockRows, [&](int blockRow)
+    {
+        if (shouldStop(deadline))
+            return;
+        
+        int y = blockRow * blockSize;
+        for (int x = 0; x < width; x += blockSize)
+        {
+            size_t idx = (size_t) y * width + x;
+            if (counts[idx] > 0)
+                continue;
+            
+            Color c;
+            sampler.drawSample(x, y, 0, c);
+            sums[idx] += c;
+            counts[idx] = 1;
+        }
+    });
+}
+
+void ProgressiveRenderer::refinePass(int sample, double deadline)
+{
+    parallelFor(0, height, [&](int y)
+    {
+        if (shouldStop(deadline))
+            return;
+        
+        for (int x = 0; x < width; x++)
+        {
+            size_t idx = (size_t) y * width + x;
+            if (counts[idx] != sample)
+                continue;
+            
+            Color c;
+            sampler.drawSample(x, y, sample, c);
+            sums[idx] += c;
+            counts[idx]++;
+        }
+    });
+}
+
+void ProgressiveRenderer::updateImage()
+{
+    vector<float> colors((size_t) width * height * 3);
+    
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            // pixels without samples yet show the corner of their 2x2 or 4x4 block
+            size_t idx = (size_t) y * width + x;
+            if (counts[idx] == 0)
+                idx = (size_t) (y & ~1) * width + (x & ~1);
+            if (counts[idx] == 0)
+                idx = (size_t) (y & ~3) * width + (x & ~3);
+            
+            Color c = sums[idx];
+            int n = counts[idx];
+            if (n > 0)
+            {
+                c.r /= n;
+                c.g /= n;
+                c.b /= n;
+            }
+            
+            size_t out = ((size_t) y * width + x) * 3;
+            colors[out + 0] = c.r;
+            colors[out + 1] = c.g;
+            colors[out + 2] = c.b;
+        }
+    });
+    
+    quantizeHDR(&colors[0], &image[0], width, height);
+}
+
+bool ProgressiveRenderer::render(double timeBudget, PublishFunction publish)
+{
+    double deadline = timeBudget > 0 ? now() + timeBudget : 0;
+    int passes = passCount();
+    outOfTime = false;
+    // a stop meant for an earlier render must not end this one at once
+    stopRequested = false;
+    
+    for (int pass = 0; pass < passes; pass++)
+    {
+        if (pass < NUM_COARSE_PASSES)
+            coarsePass(COARSE_BLOCKS[pass], deadline);
+        else
+            refinePass(pass - NUM_COARSE_PASSES + 1, deadline);
+        
+        updateImage();
+        bool stopped = stopRequested || outOfTime;
+        
+        // a pass that was cut short still improved some rows, so publish it anyway
+        publish(&image[0], stopped ? pass : pass + 1, !stopped && pass == passes - 1);
+        if (stopped)
+            return false;
+    }
+    
+    return true;
+}
+
+SharedImagePublisher::SharedImagePublisher()
+{
+    header = NULL;
+    size = 0;
+}
+
+SharedImagePublisher::~SharedImagePublisher()
+{
+    if (header)
+        munmap(header, size);
+}
+
+bool SharedImagePublisher::open(const char* name, int width, int height)
+{
+    size = sizeof(SharedImageHeader) + (size_t) width * height * 3;
+    
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    
+    if (ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    
+    void* m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    
+    header = (SharedImageHeader*) m;
+    header->sequence = 0;
+    header->magic = 'R' << 24 | 'T' << 16 | 'P' << 8 | 'R';
+    header->width = width;
+    header->height = height;
+    header->passesDone = 0;
+    header->complete = 0;
+    return true;
+}
+
+void SharedImagePublisher::publish(const unsigned char* image, int passesDone, bool complete)
+{
+    if (!header)
+        return;
+    
+    header->sequence++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    
+    memcpy(header + 1, image, (size_t) header->width * header->height * 3);
+    header->passesDone = passesDone;
+    header->complete = complete;
+    
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    header->sequence++;
+}
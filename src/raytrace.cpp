@@ -1,6 +1,28 @@
 #include <trace.h>
 #include <lodepng.h>
+#include <pngstream.h>
+#include <floatimage.h>
+#include <progressive.h>
+#include <distributed.h>
+#include <server.h>
+#include <adaptive.h>
+#include <denoise.h>
+#include <preview.h>
+#include <reproject.h>
+#include <batch.h>
+#include <bvh.h>
+#include <widebvh.h>
+#include <lazybvh.h>
+#include <grid.h>
+#include <animation.h>
+#include <util.h>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <cstring>
 
 /*************************************************
  *************** DRAWING PARAMETERS **************
@@ -10,6 +32,14 @@
 // the number of rays is antialiasingFactor^2, so
 // a value of 1 means no antialiasing takes place
 int antialiasingFactor = 2;
+// where the rays of each pixel go: REGULAR_SAMPLES, JITTERED_SAMPLES, ROTATED_GRID_SAMPLES,
+// HALTON_SAMPLES or SOBOL_SAMPLES (see trace.h). the irregular patterns need fewer
+// rays for the same quality on edges.
+SamplePattern samplePattern = REGULAR_SAMPLES;
+// TENT_FILTER or MITCHELL_FILTER take the samples on a lattice shared by neighbouring
+// pixels and blend them with that filter instead of averaging each pixel's own (see
+// trace.h). used by plain, HDR, streaming and distributed renders.
+PixelFilter pixelFilter = BOX_FILTER;
 // enables orthographic viewing
 bool orthographic = false;
 // controls the number of times the ray tracer recurses
@@ -19,23 +49,560 @@ int width = 1024;
 int height = 1024;
 // the name of the output file
 const char* outputFile = "raytrace.png";
+// when positive, the image is drawn and written to the output file in bands
+// of this many rows, so the whole image never has to be in memory at once
+int streamBandHeight = 0;
+// when set, the unclamped pixel colors are also written to this file, as a PFM image
+// if the name ends in .pfm and as raw floats otherwise (not used when streaming)
+const char* hdrOutputFile = NULL;
+// when set, these PFM files get the depth, surface normal, object id (index in
+// scene->objects plus one) and diffuse color of whatever the center ray of each
+// pixel hit first, taken from the same rays as the image (not used when streaming)
+const char* depthOutputFile = NULL;
+const char* normalOutputFile = NULL;
+const char* objectIdOutputFile = NULL;
+const char* albedoOutputFile = NULL;
+// draws the image in passes of increasing quality, replacing the output file after
+// each one, until it is done, the time budget (in seconds, if positive) runs out or
+// the process gets SIGINT or SIGTERM. the output file then has the best image so far.
+bool progressive = false;
+double progressiveTimeBudget = 0;
+// if set, progressive renders are also published to this POSIX shared memory object
+const char* progressiveSharedMemory = NULL;
+// when set, this process hands out tiles of the image to worker processes that
+// connect to this address ("host:port" or a Unix socket path) and assembles their
+// results. localWorkers of them are started on this machine; more can be started
+// anywhere with `raytrace --worker <address>`. a tile a worker has had for
+// stallTimeout seconds is also handed to the next idle worker.
+const char* coordinatorAddress = NULL;
+int localWorkers = 4;
+int tileSize = 64;
+double stallTimeout = 30;
+// when positive, the image is drawn to be done in about this many seconds, lowering
+// the antialiasing and recursion depth of tiles that wouldn't fit otherwise
+double frameTimeBudget = 0;
+// post passes for renders with few rays per pixel: when positive, pixels on the edge
+// of an object or a shadow are drawn again with this antialiasing factor, and
+// denoiseImage smooths the colors without blurring across surfaces (see denoise.h).
+// not used when streaming, drawing progressively or distributing.
+int edgeAntialiasingFactor = 0;
+bool denoiseImage = false;
+// HALF_RESOLUTION or CHECKERBOARD trace only a quarter or half of the pixels and fill
+// in the rest from neighbours on the same object, for quick previews (see preview.h).
+// the render server uses it for requests that don't say otherwise.
+PreviewMode previewMode = FULL_RESOLUTION;
+// the directory the render server writes images requests name with output= under. when
+// NULL, only clients of a server on a Unix domain socket may name output files.
+const char* serverOutputDirectory = NULL;
+// when cropWidth and cropHeight are positive, only the cropWidth x cropHeight pixels
+// from column cropLeft of row cropTop (counted from the top) are drawn, with exactly the
+// rays a full render would use for them. with cropToView, the crop is instead the pixels
+// covering the view plane from cropViewLeft to cropViewRight and cropViewBottom to
+// cropViewTop. the output file gets just those pixels, or with cropComposite they are
+// pasted into the output file as it is, which must be a png of the full image size.
+int cropLeft = 0;
+int cropTop = 0;
+int cropWidth = 0;
+int cropHeight = 0;
+bool cropToView = false;
+float cropViewLeft = 0, cropViewRight = 0, cropViewBottom = 0, cropViewTop = 0;
+bool cropComposite = false;
+// when positive, a camera fly-through of this many frames is drawn instead, moving the
+// viewpoint by cameraStep from one frame to the next, into files named like the output
+// file with the frame number added (raytrace0000.png, ...). every frame after the
+// first reuses the pixels of the one before that still hold (see reproject.h).
+int animationFrames = 0;
+Vector cameraStep(0, 0, -0.5);
+// with aimCamera, the camera looks from cameraPosition at cameraTarget instead of down
+// the negative z axis from the origin. when cameraFieldOfView is positive, the view
+// plane is resized to see that many degrees from its bottom to its top edge, with the
+// shape of the image.
+bool aimCamera = false;
+Point cameraPosition(0, 0, 0);
+Point cameraTarget(0, 0, -1);
+float cameraFieldOfView = 0;
+// when batchViews isn't NO_BATCH, the scene is drawn from several cameras into files named
+// like the output file with the view added: TURNTABLE_BATCH takes turntableViews views
+// around cameraTarget (raytrace0000.png, ...), STEREO_BATCH a left and a right eye
+// stereoSeparation apart (raytrace-left.png, raytrace-right.png) and CUBE_MAP_BATCH the
+// six faces of a cube map around the viewpoint (raytrace-px.png, ...; set width and
+// height the same). the views share the scene and are drawn two at a time while
+// finished ones are written (see batch.h).
+enum BatchViews { NO_BATCH, TURNTABLE_BATCH, STEREO_BATCH, CUBE_MAP_BATCH };
+BatchViews batchViews = NO_BATCH;
+int turntableViewCount = 8;
+float stereoSeparation = 0.065f;
+// BVH_ACCELERATOR draws through a bounding volume hierarchy over the objects, built once
+// the scene is, instead of trying every object with every ray (see bvh.h), and
+// BVH4_ACCELERATOR and BVH8_ACCELERATOR through one with four or eight children to a
+// node (see widebvh.h). LAZY_BVH_ACCELERATOR builds the BVH as rays get to each part of
+// it, so drawing starts right away (see lazybvh.h). GRID_ACCELERATOR draws through a
+// uniform grid, which builds quickest and suits many objects of about the same size
+// (see grid.h). the images are the same either way.
+enum SceneAccelerator { LINEAR_SCAN, BVH_ACCELERATOR, BVH4_ACCELERATOR, BVH8_ACCELERATOR, LAZY_BVH_ACCELERATOR,
+                        GRID_ACCELERATOR };
+SceneAccelerator sceneAccelerator = LINEAR_SCAN;
+// when positive, this many frames of the animation set up in animateScene are drawn
+// instead, into files named like the output file with the frame number added. they are
+// drawn through a BVH that is refitted every frame, and built again when that has made
+// it bvhRebuildRatio times slower than right after building, whatever sceneAccelerator
+// is (see animation.h).
+int keyframeFrames = 0;
+float bvhRebuildRatio = 1.5f;
 
 /* local functions */
 Scene* createScene();
+void setUpCamera(Scene* scene);
+void animateScene(Scene* scene, Animation &animation);
+bool drawSceneStreaming(Scene* scene);
+bool drawSceneCropped(Scene* scene);
+bool drawSceneAnimated(Scene* scene);
+bool drawSceneViews(Scene* scene);
+bool drawSceneKeyframes(Scene* scene);
+float* mapOutputFile(MappedFloatImage &image, const char* filename, int channels);
+bool drawSceneProgressive(Scene* scene);
+bool drawSceneDistributed();
 
 int main(int argc, char** argv)
 {
+    if (argc == 3 && strcmp(argv[1], "--worker") == 0)
+    {
+        std::cout << "drawing tiles for " << argv[2] << "...\n";
+        return runWorker(argv[2], createScene) ? 0 : 1;
+    }
+    
+    if (argc == 3 && strcmp(argv[1], "--server") == 0)
+    {
+        // requests use the drawing parameters above unless they say otherwise
+        NamedScene scenes[] = {{"default", createScene}};
+        RenderDefaults defaults = {width, height, recursionDepth, orthographic, antialiasingFactor, samplePattern,
+                                   previewMode};
+        std::cout << "serving render requests on " << argv[2] << "...\n";
+        return runRenderServer(argv[2], scenes, 1, defaults, serverOutputDirectory) ? 0 : 1;
+    }
+    
+    if (coordinatorAddress)
+    {
+        std::cout << "drawing scene with workers at " << coordinatorAddress << "...\n";
+        return drawSceneDistributed() ? 0 : 1;
+    }
+    
     std::cout << "creating scene...\n";
     Scene* scene = createScene();
+    
+    // keyframes are drawn through a BVH of their own, so don't build one that is never used
+    if (keyframeFrames > 0)
+    {
+        std::cout << "drawing " << keyframeFrames << " keyframed frames...\n";
+        return drawSceneKeyframes(scene) ? 0 : 1;
+    }
+    
+    if (sceneAccelerator != LINEAR_SCAN)
+    {
+        std::cout << (sceneAccelerator == GRID_ACCELERATOR ? "building grid...\n" : "building BVH...\n");
+        if (sceneAccelerator == GRID_ACCELERATOR)
+            scene->accelerator = new Grid(scene);
+        else if (sceneAccelerator == BVH4_ACCELERATOR)
+            scene->accelerator = new BVH4(scene);
+        else if (sceneAccelerator == BVH8_ACCELERATOR)
+            scene->accelerator = new BVH8(scene);
+        else if (sceneAccelerator == LAZY_BVH_ACCELERATOR)
+            scene->accelerator = new LazyBVH(scene);
+        else
+            scene->accelerator = new BVH(scene);
+    }
+    
+    if (streamBandHeight > 0)
+    {
+        std::cout << "drawing scene and writing it to file in bands...\n";
+        return drawSceneStreaming(scene) ? 0 : 1;
+    }
+    
+    if (progressive)
+    {
+        std::cout << "drawing scene progressively...\n";
+        return drawSceneProgressive(scene) ? 0 : 1;
+    }
+    
+    if ((cropWidth > 0 && cropHeight > 0) || cropToView)
+    {
+        std::cout << "drawing part of the scene...\n";
+        return drawSceneCropped(scene) ? 0 : 1;
+    }
+    
+    if (animationFrames > 0)
+    {
+        std::cout << "drawing " << animationFrames << " frames...\n";
+        return drawSceneAnimated(scene) ? 0 : 1;
+    }
+    
+    if (batchViews != NO_BATCH)
+    {
+        std::cout << "drawing scene from several views...\n";
+        return drawSceneViews(scene) ? 0 : 1;
+    }
+    
     unsigned char* canvas = new unsigned char[width * height * 3];
     
-    std::cout << "drawing scene...\n";
-    drawScene(scene, canvas, width, height, recursionDepth, orthographic, antialiasingFactor);
+    if (frameTimeBudget > 0)
+    {
+        std::cout << "drawing scene within " << frameTimeBudget << " seconds...\n";
+        QualityReport report = drawSceneWithDeadline(scene, canvas, width, height, recursionDepth, orthographic,
+                                                     antialiasingFactor, frameTimeBudget, 32, samplePattern);
+        std::cout << "took " << report.seconds << " seconds, " << report.fullQualityTiles << "/"
+                  << report.tileCount << " tiles at full quality, antialiasing " << report.minAntialias
+                  << "-" << report.maxAntialias << ", depth " << report.minDepth << "-" << report.maxDepth
+                  << ", " << report.averageSamples << " samples per pixel\n";
+        std::cout << "writing scene to file...\n";
+        return lodepng_encode24_file(outputFile, canvas, width, height) ? 1 : 0;
+    }
+    
+    if (previewMode != FULL_RESOLUTION)
+    {
+        std::cout << "drawing preview...\n";
+        int traced = drawScenePreview(scene, canvas, width, height, recursionDepth, orthographic, antialiasingFactor,
+                                      previewMode, samplePattern);
+        std::cout << traced << " of " << width * height << " pixels traced\n";
+        std::cout << "writing scene to file...\n";
+        return lodepng_encode24_file(outputFile, canvas, width, height) ? 1 : 0;
+    }
+    
+    bool postPasses = edgeAntialiasingFactor > 0 || denoiseImage;
+    bool extraOutputs = depthOutputFile || normalOutputFile || objectIdOutputFile || albedoOutputFile || postPasses;
+    
+    if (hdrOutputFile || extraOutputs)
+    {
+        // draw straight into the mapped files, then derive the png from the colors
+        MappedFloatImage hdr, depth, normal, objectId, albedo;
+        vector<float> colors;
+        float* hdrPixels = mapOutputFile(hdr, hdrOutputFile, 3);
+        if (!hdrPixels)
+        {
+            colors.resize((size_t) width * height * 3);
+            hdrPixels = &colors[0];
+        }
+        
+        RenderOutputs outputs;
+        outputs.depth = mapOutputFile(depth, depthOutputFile, 1);
+        outputs.normal = mapOutputFile(normal, normalOutputFile, 3);
+        outputs.objectId = mapOutputFile(objectId, objectIdOutputFile, 1);
+        outputs.albedo = mapOutputFile(albedo, albedoOutputFile, 3);
+        
+        // the post passes are guided by all the outputs, so keep any that aren't written in memory
+        vector<float> guides;
+        if (postPasses)
+        {
+            size_t pixels = (size_t) width * height;
+            guides.resize(pixels * 8);
+            if (!outputs.depth)
+                outputs.depth = &guides[0];
+            if (!outputs.normal)
+                outputs.normal = &guides[pixels];
+            if (!outputs.objectId)
+                outputs.objectId = &guides[pixels * 4];
+            if (!outputs.albedo)
+                outputs.albedo = &guides[pixels * 5];
+        }
+        
+        std::cout << "drawing scene...\n";
+        drawSceneHDR(scene, hdrPixels, width, height, recursionDepth, orthographic, antialiasingFactor,
+                     extraOutputs ? &outputs : NULL, samplePattern, pixelFilter);
+        if (edgeAntialiasingFactor > 0)
+        {
+            std::cout << "redrawing edges...\n";
+            int edges = redrawEdges(scene, hdrPixels, width, height, outputs, recursionDepth, orthographic,
+                                    edgeAntialiasingFactor, samplePattern);
+            std::cout << edges << " of " << width * height << " pixels redrawn\n";
+        }
+        if (denoiseImage)
+        {
+            std::cout << "denoising...\n";
+            denoise(hdrPixels, width, height, outputs);
+        }
+        quantizeHDR(hdrPixels, canvas, width, height);
+    }
+    else
+    {
+        std::cout << "drawing scene...\n";
+        drawScene(scene, canvas, width, height, recursionDepth, orthographic, antialiasingFactor, samplePattern,
+                  pixelFilter);
+    }
     
     std::cout << "writing scene to file...\n";
     lodepng_encode24_file(outputFile, canvas, width, height);
 }
 
+bool drawSceneCropped(Scene* scene)
+{
+    CropWindow crop = {cropLeft, cropTop, cropWidth, cropHeight};
+    if (cropToView)
+        crop = cropToViewPlane(scene, width, height, cropViewLeft, cropViewRight, cropViewBottom, cropViewTop);
+    
+    if (crop.width <= 0 || crop.height <= 0 || crop.left < 0 || crop.top < 0 ||
+        crop.left + crop.width > width || crop.top + crop.height > height)
+    {
+        std::cerr << "the crop window is not inside the image\n";
+        return false;
+    }
+    
+    // check the image to composite into before spending time on drawing
+    unsigned char* image = NULL;
+    unsigned error;
+    if (cropComposite)
+    {
+        unsigned imageWidth, imageHeight;
+        error = lodepng_decode24_file(&image, &imageWidth, &imageHeight, outputFile);
+        if (error)
+        {
+            std::cerr << "could not read " << outputFile << ": " << lodepng_error_text(error) << "\n";
+            return false;
+        }
+        if ((int) imageWidth != width || (int) imageHeight != height)
+        {
+            std::cerr << outputFile << " is " << imageWidth << "x" << imageHeight << ", not " << width << "x"
+                      << height << "\n";
+            free(image);
+            return false;
+        }
+    }
+    
+    vector<unsigned char> region((size_t) crop.width * crop.height * 3);
+    drawSceneTile(scene, &region[0], width, height, crop.left, crop.top, crop.width, crop.height, recursionDepth,
+                  orthographic, antialiasingFactor, samplePattern, pixelFilter);
+    
+    if (image)
+    {
+        for (int row = 0; row < crop.height; row++)
+            memcpy(image + ((size_t) (crop.top + row) * width + crop.left) * 3,
+                   &region[(size_t) row * crop.width * 3], (size_t) crop.width * 3);
+        error = lodepng_encode24_file(outputFile, image, width, height);
+        free(image);
+    }
+    else
+        error = lodepng_encode24_file(outputFile, &region[0], crop.width, crop.height);
+    
+    if (error)
+    {
+        std::cerr << "could not write " << outputFile << ": " << lodepng_error_text(error) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool drawSceneAnimated(Scene* scene)
+{
+    TemporalRenderer renderer(scene, width, height, recursionDepth, orthographic, antialiasingFactor, samplePattern);
+    vector<unsigned char> canvas((size_t) width * height * 3);
+    
+    for (int frame = 0; frame < animationFrames; frame++)
+    {
+        ReuseStats stats = renderer.drawFrame(&canvas[0]);
+        
+        char number[16];
+        snprintf(number, sizeof(number), "%04d", frame);
+        std::string frameFile = numberedFileName(outputFile, number);
+        unsigned error = lodepng_encode24_file(frameFile.c_str(), &canvas[0], width, height);
+        if (error)
+        {
+            std::cerr << "could not write " << frameFile << ": " << lodepng_error_text(error) << "\n";
+            return false;
+        }
+        
+        std::cout << "frame " << frame << ": " << stats.pixelsReused << " of " << width * height << " pixels reused, "
+                  << (int) (stats.raysSaved() * 100 + 0.5f) << "% of camera rays saved\n";
+        scene->viewpoint = scene->viewpoint + cameraStep;
+    }
+    return true;
+}
+
+bool drawSceneViews(Scene* scene)
+{
+    vector<View> views;
+    if (batchViews == TURNTABLE_BATCH)
+        views = turntableViews(scene, cameraTarget, turntableViewCount);
+    else if (batchViews == STEREO_BATCH)
+        views = stereoViews(scene, stereoSeparation);
+    else
+        views = cubeMapViews(scene);
+    
+    vector<ViewTimings> timings;
+    double start = now();
+    bool written = drawViews(scene, views, outputFile, width, height, recursionDepth, orthographic,
+                             antialiasingFactor, samplePattern, &timings);
+    double seconds = now() - start;
+    
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        std::cout << "view " << views[i].name << ": drawn in " << timings[i].renderSeconds << " s, written in "
+                  << timings[i].encodeSeconds << " s\n";
+        if (!timings[i].written)
+            std::cerr << "could not write view " << views[i].name << "\n";
+    }
+    std::cout << views.size() << " views in " << seconds << " s\n";
+    return written;
+}
+
+bool drawSceneKeyframes(Scene* scene)
+{
+    Animation animation;
+    animateScene(scene, animation);
+    
+    vector<FrameTimings> timings;
+    bool written = drawKeyframes(scene, animation, keyframeFrames, outputFile, width, height, recursionDepth,
+                                 orthographic, antialiasingFactor, samplePattern, bvhRebuildRatio, &timings);
+    
+    for (int frame = 0; frame < keyframeFrames; frame++)
+    {
+        const FrameTimings &t = timings[frame];
+        std::cout << "frame " << frame << ": " << (t.rebuilt ? "built" : "refitted") << " in " << t.bvhSeconds
+                  << " s, drawn in " << t.renderSeconds << " s, written in " << t.encodeSeconds << " s"
+                  << (t.written ? "" : ", could not write the image") << "\n";
+    }
+    return written;
+}
+
+// maps an output file for drawSceneHDR, or returns NULL if filename is NULL
+float* mapOutputFile(MappedFloatImage &image, const char* filename, int channels)
+{
+    if (!filename)
+        return NULL;
+    
+    if (!image.create(filename, width, height, channels))
+    {
+        std::cerr << "could not create " << filename << "\n";
+        exit(1);
+    }
+    return image.pixels;
+}
+
+bool drawSceneDistributed()
+{
+    DistributedSettings settings;
+    settings.width = width;
+    settings.height = height;
+    settings.maxDepth = recursionDepth;
+    settings.orthographic = orthographic;
+    settings.antialiasFactor = antialiasingFactor;
+    settings.samplePattern = samplePattern;
+    settings.pixelFilter = pixelFilter;
+    settings.tileSize = tileSize;
+    settings.stallTimeout = stallTimeout;
+    if (tileSize <= 0)
+    {
+        std::cerr << "tileSize must be positive\n";
+        return false;
+    }
+    
+    unsigned char* canvas = new unsigned char[(size_t) width * height * 3];
+    if (!coordinateRender(coordinatorAddress, settings, localWorkers, createScene, canvas))
+    {
+        std::cerr << "could not listen on " << coordinatorAddress << "\n";
+        return false;
+    }
+    
+    std::cout << "writing scene to file...\n";
+    return lodepng_encode24_file(outputFile, canvas, width, height) == 0;
+}
+
+void onStopSignal(int)
+{
+    stopProgressiveRender();
+}
+
+bool drawSceneProgressive(Scene* scene)
+{
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+    
+    SharedImagePublisher shared;
+    if (progressiveSharedMemory && !shared.open(progressiveSharedMemory, width, height))
+    {
+        std::cerr << "could not create shared memory " << progressiveSharedMemory << "\n";
+        return false;
+    }
+    
+    // write to a temporary file and rename it, so readers never see a half written image
+    std::string tempFile = std::string(outputFile) + ".tmp";
+    bool written = true;
+    
+    ProgressiveRenderer renderer(scene, width, height, recursionDepth, orthographic, antialiasingFactor,
+                                 samplePattern);
+    int passes = renderer.passCount();
+    int lastPasses = -1;
+    
+    renderer.render(progressiveTimeBudget, [&](const unsigned char* image, int passesDone, bool complete)
+    {
+        shared.publish(image, passesDone, complete);
+        
+        unsigned error = lodepng_encode24_file(tempFile.c_str(), image, width, height);
+        written = !error && rename(tempFile.c_str(), outputFile) == 0;
+        
+        if (passesDone == lastPasses)
+            std::cout << "stopped during pass " << passesDone + 1;
+        else
+            std::cout << "pass " << passesDone << "/" << passes << (complete ? " (complete)" : "");
+        std::cout << (written ? "" : ", could not write the image") << "\n";
+        lastPasses = passesDone;
+    });
+    
+    return written;
+}
+
+bool drawSceneStreaming(Scene* scene)
+{
+    PNGStreamWriter writer;
+    unsigned error = writer.open(outputFile, width, height);
+    unsigned char* band = new unsigned char[(size_t) width * streamBandHeight * 3];
+    
+    for (int row = 0; row < height && !error; row += streamBandHeight)
+    {
+        int numRows = std::min(streamBandHeight, height - row);
+        drawSceneRows(scene, band, width, height, row, numRows, recursionDepth, orthographic, antialiasingFactor,
+                      samplePattern, pixelFilter);
+        error = writer.writeRows(band, numRows);
+    }
+    
+    if (!error)
+        error = writer.close();
+    delete[] band;
+    
+    if (error)
+    {
+        std::cerr << "could not write " << outputFile << ": " << lodepng_error_text(error) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// applies the camera settings at the top of this file
+void setUpCamera(Scene* scene)
+{
+    if (aimCamera)
+        pointCamera(scene, cameraPosition, cameraTarget, Vector(0,1,0));
+    if (cameraFieldOfView > 0)
+        setFieldOfView(scene, cameraFieldOfView, (float) width / height);
+}
+
+// keys the animation drawn with keyframeFrames, for the objects and lights createScene
+// makes, in the order it makes them
+void animateScene(Scene* scene, Animation &animation)
+{
+    // the red sphere bounces twice
+    GeometricObject* sphere = scene->objects[3];
+    animation.moveObject(sphere, 0, Vector(0,0,0));
+    animation.moveObject(sphere, 1, Vector(0,6,0));
+    animation.moveObject(sphere, 2, Vector(0,0,0));
+    animation.moveObject(sphere, 3, Vector(0,6,0));
+    animation.moveObject(sphere, 4, Vector(0,0,0));
+    
+    // the first light crosses the room with its sphere
+    Vector across(-18,0,0);
+    animation.moveLight(scene->pointLights[0], 0, Vector(0,0,0));
+    animation.moveLight(scene->pointLights[0], 4, across);
+    animation.moveObject(scene->objects[0], 0, Vector(0,0,0));
+    animation.moveObject(scene->objects[0], 4, across);
+}
+
 #define Z (-20)
 
 Scene* createScene() {
@@ -200,5 +767,6 @@ Scene* createScene() {
     scene->objects.push_back(zerg);
     scene->objects.push_back(terran);
     
+    setUpCamera(scene);
     return scene;
 }
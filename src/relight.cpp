@@ -0,0 +1,114 @@
+#include <relight.h>
+#include <parallel.h>
+
+#include <algorithm>
+
+Relighter::Relighter(Scene* scene, int width, int height, int maxDepth, bool orthographic, int antialias,
+                     SamplePattern pattern)
+{
+    this->scene = scene;
+    this->width = width;
+    this->height = height;
+    this->maxDepth = maxDepth;
+    this->orthographic = orthographic;
+    this->antialias = antialias;
+    this->pattern = pattern;
+    d = antialias * antialias;
+}
+
+void Relighter::shadeAll(int lights, vector<float> &colors)
+{
+    colors.resize((size_t) width * height * 3);
+    
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t p = (size_t) y * width + x;
+            Color pixelColor(0,0,0);
+            
+            // the same sum drawPixel makes
+            for (int sample = 0; sample < d; sample++)
+            {
+                Color c;
+                shade(scene, &rays[p * d + sample], hits[p * d + sample], maxDepth, c, lights);
+                pixelColor += c;
+            }
+            
+            colors[p * 3 + 0] = pixelColor.r / d;
+            colors[p * 3 + 1] = pixelColor.g / d;
+            colors[p * 3 + 2] = pixelColor.b / d;
+        }
+    });
+}
+
+void Relighter::drawAll()
+{
+    // the camera may have changed since the last time
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialias, pattern);
+    rays.resize((size_t) width * height * d);
+    hits.resize(rays.size());
+    
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            for (int sample = 0; sample < d; sample++)
+            {
+                size_t i = ((size_t) y * width + x) * d + sample;
+                sampler.primaryRay(x, y, sample, rays[i]);
+                findFirstHit(scene, &rays[i], hits[i]);
+            }
+        }
+    });
+    
+    shadeAll(NO_LIGHTS, unlit);
+    lit.resize(scene->pointLights.size());
+    for (size_t light = 0; light < lit.size(); light++)
+        shadeAll(light, lit[light]);
+}
+
+void Relighter::lightChanged(PointLight* light)
+{
+    vector<PointLight*> &lights = scene->pointLights;
+    size_t index = std::find(lights.begin(), lights.end(), light) - lights.begin();
+    // before drawAll there are no hits to shade, and drawAll shades every light
+    if (index == lights.size() || hits.empty())
+        return;
+    
+    // lights added before this one but not passed here need their parts too
+    for (size_t i = lit.size(); i < index; i++)
+    {
+        lit.emplace_back();
+        shadeAll(i, lit[i]);
+    }
+    if (index >= lit.size())
+        lit.resize(index + 1);
+    shadeAll(index, lit[index]);
+}
+
+void Relighter::lightRemoved(int index)
+{
+    if (index >= 0 && (size_t) index < lit.size())
+        lit.erase(lit.begin() + index);
+}
+
+void Relighter::draw(unsigned char* buffer)
+{
+    size_t lights = std::min(lit.size(), scene->pointLights.size());
+    
+    parallelFor(0, height, [&](int y)
+    {
+        // rows count down from the top of the image, y counts up from the bottom of the view plane
+        unsigned char* out = buffer + (size_t) (height - y - 1) * width * 3;
+        
+        for (int x = 0; x < width; x++, out += 3)
+        {
+            size_t p = ((size_t) y * width + x) * 3;
+            Color c(unlit[p], unlit[p + 1], unlit[p + 2]);
+            for (size_t light = 0; light < lights; light++)
+                c += scene->pointLights[light]->color * Color(lit[light][p], lit[light][p + 1], lit[light][p + 2]);
+            quantizePixel(c, out);
+        }
+    });
+}
@@ -0,0 +1,234 @@
+#include <renderpool.h>
+#include <parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+struct RenderJobState {
+    Scene* scene;
+    unsigned char* buffer;
+    int width, height;
+    int maxDepth;
+    bool orthographic;
+    int antialiasFactor;
+    SamplePattern pattern;
+    int tileSize, tilesAcross, tileCount;
+    
+    // guarded by the pool's mutex: the next tile nobody has started and how many
+    // tiles are being drawn. the job is in the pool's queue iff nextTile < tileCount.
+    int nextTile;
+    int inFlight;
+    
+    std::atomic<int> tilesDone;
+    std::atomic<bool> cancelled;
+    
+    // guarded by mutex
+    std::mutex mutex;
+    std::condition_variable finishedChanged;
+    bool finished;
+    bool complete;
+    vector<std::function<void(bool)> > continuations;
+};
+
+// marks a job as done, wakes up everyone waiting for it and runs its continuations
+static void finishJob(const std::shared_ptr<RenderJobState> &job)
+{
+    vector<std::function<void(bool)> > continuations;
+    bool complete = job->tilesDone == job->tileCount;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        job->complete = complete;
+        continuations.swap(job->continuations);
+    }
+    job->finishedChanged.notify_all();
+    
+    for (size_t i = 0; i < continuations.size(); i++)
+        continuations[i](complete);
+}
+
+// draws tile number `tile` of a job straight into its buffer
+static void drawTile(RenderJobState &job, int tile)
+{
+    int left = (tile % job.tilesAcross) * job.tileSize;
+    int top = (tile / job.tilesAcross) * job.tileSize;
+    int tileWidth = std::min(job.tileSize, job.width - left);
+    int tileHeight = std::min(job.tileSize, job.height - top);
+    
+    vector<unsigned char> pixels((size_t) tileWidth * tileHeight * 3);
+    drawSceneTile(job.scene, &pixels[0], job.width, job.height, left, top, tileWidth, tileHeight,
+                  job.maxDepth, job.orthographic, job.antialiasFactor, job.pattern);
+    
+    for (int row = 0; row < tileHeight; row++)
+        memcpy(job.buffer + ((size_t) (top + row) * job.width + left) * 3,
+               &pixels[(size_t) row * tileWidth * 3], (size_t) tileWidth * 3);
+}
+
+/*************************************************
+ ******************* RENDER JOB ******************
+ *************************************************/
+
+int RenderJob::tilesDone()
+{
+    return state->tilesDone;
+}
+
+int RenderJob::tileCount()
+{
+    return state->tileCount;
+}
+
+void RenderJob::cancel()
+{
+    // the pool notices the next time the job's turn comes up or one of its tiles is done
+    state->cancelled = true;
+}
+
+bool RenderJob::done()
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->finished;
+}
+
+bool RenderJob::wait()
+{
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finishedChanged.wait(lock, [&]() { return state->finished; });
+    return state->complete;
+}
+
+void RenderJob::then(std::function<void(bool complete)> continuation)
+{
+    bool complete;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->finished)
+        {
+            state->continuations.push_back(continuation);
+            return;
+        }
+        complete = state->complete;
+    }
+    continuation(complete);
+}
+
+/*************************************************
+ ****************** RENDER POOL ******************
+ *************************************************/
+
+RenderPool::RenderPool(int numThreads)
+{
+    stopping = false;
+    if (numThreads <= 0)
+        numThreads = threadCount();
+    
+    for (int i = 0; i < numThreads; i++)
+        threads.push_back(std::thread(&RenderPool::work, this));
+}
+
+RenderPool::~RenderPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (size_t i = 0; i < queue.size(); i++)
+            queue[i]->cancelled = true;
+    }
+    wakeUp.notify_all();
+    
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+RenderJob RenderPool::submit(Scene* s, unsigned char* buffer, int width, int height, int maxDepth,
+                             bool orthographic, int antialiasFactor, int tileSize, SamplePattern pattern)
+{
+    std::shared_ptr<RenderJobState> job = std::make_shared<RenderJobState>();
+    job->scene = s;
+    job->buffer = buffer;
+    job->width = width;
+    job->height = height;
+    job->maxDepth = maxDepth;
+    job->orthographic = orthographic;
+    job->antialiasFactor = antialiasFactor;
+    job->pattern = pattern;
+    job->tileSize = std::max(tileSize, 1);
+    job->tilesAcross = (width + job->tileSize - 1) / job->tileSize;
+    job->tileCount = width > 0 && height > 0 ? job->tilesAcross * ((height + job->tileSize - 1) / job->tileSize) : 0;
+    job->nextTile = 0;
+    job->inFlight = 0;
+    job->tilesDone = 0;
+    job->cancelled = false;
+    job->finished = false;
+    job->complete = false;
+    
+    RenderJob handle;
+    handle.state = job;
+    
+    if (job->tileCount == 0)
+    {
+        finishJob(job);
+        return handle;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(job);
+    }
+    wakeUp.notify_one();
+    return handle;
+}
+
+void RenderPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    for (;;)
+    {
+        wakeUp.wait(lock, [&]() { return stopping || !queue.empty(); });
+        if (queue.empty())
+            return;
+        
+        // take one tile from the job at the front, then send it to the back of the line
+        std::shared_ptr<RenderJobState> job = queue.front();
+        queue.pop_front();
+        
+        if (job->cancelled)
+        {
+            // drop the tiles nobody has started. if some are being drawn, whoever
+            // finishes the last of them finishes the job.
+            job->nextTile = job->tileCount;
+            if (job->inFlight == 0)
+            {
+                lock.unlock();
+                finishJob(job);
+                lock.lock();
+            }
+            continue;
+        }
+        
+        int tile = job->nextTile++;
+        job->inFlight++;
+        if (job->nextTile < job->tileCount)
+        {
+            queue.push_back(job);
+            // there is more work than this thread can take
+            wakeUp.notify_one();
+        }
+        
+        lock.unlock();
+        drawTile(*job, tile);
+        job->tilesDone++;
+        lock.lock();
+        
+        // whoever draws the last tile of a job that left the queue finishes it
+        job->inFlight--;
+        if (job->inFlight == 0 && job->nextTile == job->tileCount)
+        {
+            lock.unlock();
+            finishJob(job);
+            lock.lock();
+        }
+    }
+}
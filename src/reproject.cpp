@@ -0,0 +1,172 @@
+#include <reproject.h>
+#include <parallel.h>
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+// how far, in pixels where it is seen, a reused color may have been shaded from the
+// point it is reused for
+#define REPROJECT_TOLERANCE 0.75f
+// the least cosine between the normals of a pixel and the one it reuses
+#define MIN_NORMAL_COSINE 0.95f
+// a color differing from a neighbour's by more than this in any channel is on the edge of
+// a shadow or a texture detail, which moves too much for it to be reused
+#define MAX_CONTRAST 0.1f
+
+TemporalRenderer::TemporalRenderer(Scene* scene, int width, int height, int maxDepth, bool orthographic,
+                                   int antialias, SamplePattern pattern)
+{
+    this->scene = scene;
+    this->width = width;
+    this->height = height;
+    this->maxDepth = maxDepth;
+    this->orthographic = orthographic;
+    this->antialias = antialias;
+    this->pattern = pattern;
+    hasPrevious = false;
+}
+
+int TemporalRenderer::previousPixel(Point point)
+{
+    // where point was in the previous camera's coordinates
+    Vector offset = point - previousViewpoint;
+    Vector q(dot(offset, previousRight), dot(offset, previousUp), dot(offset, cross(previousRight, previousUp)));
+    
+    // rays start on the view plane, so nothing closer was seen
+    if (q.z >= scene->viewPlaneZ)
+        return -1;
+    
+    float planeX = q.x, planeY = q.y;
+    if (!orthographic)
+    {
+        float scale = scene->viewPlaneZ / q.z;
+        planeX *= scale;
+        planeY *= scale;
+    }
+    
+    float x = (planeX - scene->viewPlaneLeft) / (scene->viewPlaneRight - scene->viewPlaneLeft) * width;
+    float y = (planeY - scene->viewPlaneBottom) / (scene->viewPlaneTop - scene->viewPlaneBottom) * height;
+    if (!(x >= 0 && x < width && y >= 0 && y < height))
+        return -1;
+    return (int) y * width + (int) x;
+}
+
+float TemporalRenderer::footprint(Point point)
+{
+    float pixel = std::max((scene->viewPlaneRight - scene->viewPlaneLeft) / width,
+                           (scene->viewPlaneTop - scene->viewPlaneBottom) / height);
+    if (orthographic)
+        return pixel;
+    float depth = dot(scene->viewpoint - point, cross(scene->viewRight, scene->viewUp));
+    return pixel * depth / -scene->viewPlaneZ;
+}
+
+// the squared distance between two points
+static inline float distanceSquared(Point a, Point b)
+{
+    Vector d = a - b;
+    return d.x * d.x + d.y * d.y + d.z * d.z;
+}
+
+ReuseStats TemporalRenderer::drawFrame(unsigned char* buffer)
+{
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialias, pattern);
+    size_t pixels = (size_t) width * height;
+    vector<PrimaryHit> hits(pixels);
+    
+    // what the center of every pixel shows now
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+            sampler.findCenterHit(x, y, hits[(size_t) y * width + x]);
+    });
+    
+    current.resize(pixels);
+    vector<float> colors(pixels * 3);
+    std::atomic<int> reused(0);
+    
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t p = (size_t) y * width + x;
+            const PrimaryHit &hit = hits[p];
+            PixelRecord &record = current[p];
+            
+            // a pixel on the edge of an object mixes it with what is behind
+            bool edge = (x > 0 && hits[p - 1].object != hit.object) ||
+                        (x < width - 1 && hits[p + 1].object != hit.object) ||
+                        (y > 0 && hits[p - width].object != hit.object) ||
+                        (y < height - 1 && hits[p + width].object != hit.object);
+            
+            int q = hasPrevious && hit.object ? previousPixel(hit.point) : -1;
+            if (q >= 0)
+            {
+                const PixelRecord &before = previous[q];
+                float tolerance = REPROJECT_TOLERANCE * footprint(hit.point);
+                if (!before.reusable || before.object != hit.object ||
+                    dot(before.normal, hit.normal) < MIN_NORMAL_COSINE ||
+                    distanceSquared(before.shadedAt, hit.point) > tolerance * tolerance)
+                    q = -1;
+            }
+            
+            if (q >= 0)
+            {
+                record = previous[q];
+                record.reusable = !edge;
+                reused++;
+            }
+            else
+            {
+                sampler.shadePixel(x, y, hit, record.color);
+                
+                const Material &m = hit.material;
+                bool viewDependent = m.specular.r != 0 || m.specular.g != 0 || m.specular.b != 0 ||
+                                     m.refracted.r != 0 || m.refracted.g != 0 || m.refracted.b != 0;
+                record.object = hit.object;
+                record.normal = hit.normal;
+                record.shadedAt = hit.point;
+                record.reusable = hit.object && !viewDependent && !edge;
+            }
+            
+            colors[p * 3 + 0] = record.color.r;
+            colors[p * 3 + 1] = record.color.g;
+            colors[p * 3 + 2] = record.color.b;
+        }
+    });
+    
+    // colors on sharp changes in color can't be reused either
+    parallelFor(0, height, [&](int y)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t p = (size_t) y * width + x;
+            size_t neighbours[4] = {x > 0 ? p - 1 : p, x < width - 1 ? p + 1 : p,
+                                    y > 0 ? p - width : p, y < height - 1 ? p + width : p};
+            for (int i = 0; i < 4 && current[p].reusable; i++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    if (fabsf(colors[p * 3 + c] - colors[neighbours[i] * 3 + c]) > MAX_CONTRAST)
+                        current[p].reusable = false;
+                }
+            }
+        }
+    });
+    
+    quantizeHDR(&colors[0], buffer, width, height);
+    
+    current.swap(previous);
+    previousViewpoint = scene->viewpoint;
+    previousRight = scene->viewRight;
+    previousUp = scene->viewUp;
+    hasPrevious = true;
+    
+    // every pixel traced its center ray to test it, and the others the rest of their rays
+    ReuseStats stats;
+    stats.pixelsReused = reused;
+    stats.fullFrameRays = (long) pixels * sampler.samplesPerPixel();
+    stats.raysTraced = pixels + (long) (pixels - reused) * (sampler.samplesPerPixel() - 1);
+    return stats;
+}
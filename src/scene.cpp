@@ -1,6 +1,39 @@
 #include <scene.h>
+#include <algorithm>
 #include <cmath>
 
+Scene::Scene()
+{
+    viewRight = Vector(1,0,0);
+    viewUp = Vector(0,1,0);
+    accelerator = NULL;
+}
+
+Bounds::Bounds()
+{
+    min = Point(INFINITY, INFINITY, INFINITY);
+    max = Point(-INFINITY, -INFINITY, -INFINITY);
+}
+
+Bounds::Bounds(Point min, Point max)
+{
+    this->min = min;
+    this->max = max;
+}
+
+void Bounds::add(const Bounds &b)
+{
+    min = Point(std::min(min.x, b.min.x), std::min(min.y, b.min.y), std::min(min.z, b.min.z));
+    max = Point(std::max(max.x, b.max.x), std::max(max.y, b.max.y), std::max(max.z, b.max.z));
+}
+
+bool Bounds::overlaps(const Bounds &b) const
+{
+    return min.x <= b.max.x && b.min.x <= max.x &&
+           min.y <= b.max.y && b.min.y <= max.y &&
+           min.z <= b.max.z && b.min.z <= max.z;
+}
+
 class SphereIntersection : public Intersection 
 {
     public:
@@ -83,6 +116,17 @@ Intersection* Sphere::intersect(Ray* ray)
     return i;
 }
 
+void Sphere::getBounds(Point &min, Point &max)
+{
+    min = Point(center.x - radius, center.y - radius, center.z - radius);
+    max = Point(center.x + radius, center.y + radius, center.z + radius);
+}
+
+void Sphere::translate(Vector offset)
+{
+    center = center + offset;
+}
+
 class PlaneIntersection : public Intersection
 {
     public:
@@ -134,6 +178,24 @@ Intersection* Plane::intersect(Ray* ray)
     return i;
 }
 
+void Plane::getBounds(Point &min, Point &max)
+{
+    // a plane is only bounded along an axis it is perpendicular to
+    min = Point(-INFINITY, -INFINITY, -INFINITY);
+    max = Point(INFINITY, INFINITY, INFINITY);
+    if (normal.y == 0 && normal.z == 0)
+        min.x = max.x = point.x;
+    if (normal.x == 0 && normal.z == 0)
+        min.y = max.y = point.y;
+    if (normal.x == 0 && normal.y == 0)
+        min.z = max.z = point.z;
+}
+
+void Plane::translate(Vector offset)
+{
+    point = point + offset;
+}
+
 class RectangleIntersection : public Intersection
 {
     public:
@@ -203,6 +265,23 @@ Intersection* Rectangle::intersect(Ray* ray)
     return i;
 }
 
+void Rectangle::getBounds(Point &min, Point &max)
+{
+    // intersect lets rays hit up to EPSILON outside the rectangle
+    min = Point(xMin - EPSILON, yMin - EPSILON, zMin - EPSILON);
+    max = Point(xMax + EPSILON, yMax + EPSILON, zMax + EPSILON);
+}
+
+void Rectangle::translate(Vector offset)
+{
+    xMin += offset.x;
+    xMax += offset.x;
+    yMin += offset.y;
+    yMax += offset.y;
+    zMin += offset.z;
+    zMax += offset.z;
+}
+
 class TexturedRectangleIntersection : public Intersection
 {
     public:
@@ -0,0 +1,280 @@
+#include <server.h>
+#include <trace.h>
+#include <net.h>
+#include <lodepng.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// requests are short; anything longer than this is not a request
+#define MAX_REQUEST_LENGTH 4096
+// the largest image a single request may ask for, in each dimension
+#define MAX_IMAGE_SIZE 16384
+
+struct SceneRegistry {
+    const NamedScene* scenes;
+    int numScenes;
+    RenderDefaults defaults;
+    // where output= paths are written under, or NULL to only write them for clients
+    // on a Unix domain socket, relative to the working directory
+    const char* outputDirectory;
+    bool local;
+    
+    // scenes that have been built, by name. they are never freed.
+    std::map<std::string, Scene*> built;
+    std::mutex mutex;
+};
+
+// returns the scene called name, building it if this is the first request for it,
+// or NULL if there is no such scene
+static Scene* findScene(SceneRegistry &registry, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::map<std::string, Scene*>::iterator cached = registry.built.find(name);
+    if (cached != registry.built.end())
+        return cached->second;
+    
+    for (int i = 0; i < registry.numScenes; i++)
+    {
+        if (name == registry.scenes[i].name)
+        {
+            Scene* scene = registry.scenes[i].create();
+            registry.built[name] = scene;
+            return scene;
+        }
+    }
+    return NULL;
+}
+
+// reads one line, without the newline. returns false if the connection closed first
+// or the line is too long.
+static bool readLine(int fd, std::string &line)
+{
+    line.clear();
+    char c;
+    while (recv(fd, &c, 1, 0) == 1)
+    {
+        if (c == '\n')
+            return true;
+        if (line.size() >= MAX_REQUEST_LENGTH)
+            return false;
+        line += c;
+    }
+    return false;
+}
+
+static bool sendLine(int fd, const std::string &line)
+{
+    std::string withNewline = line + "\n";
+    return sendAll(fd, withNewline.data(), withNewline.size());
+}
+
+static bool parseInt(const std::string &value, int low, int high, int &result)
+{
+    char* end;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end || parsed < low || parsed > high)
+        return false;
+    result = parsed;
+    return true;
+}
+
+static bool parsePattern(const std::string &value, SamplePattern &result)
+{
+    const char* names[] = {"regular", "jittered", "rotated", "halton", "sobol"};
+    const SamplePattern patterns[] = {REGULAR_SAMPLES, JITTERED_SAMPLES, ROTATED_GRID_SAMPLES,
+                                      HALTON_SAMPLES, SOBOL_SAMPLES};
+    for (int i = 0; i < 5; i++)
+    {
+        if (value == names[i])
+        {
+            result = patterns[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parsePreview(const std::string &value, PreviewMode &result)
+{
+    const char* names[] = {"full", "half", "checkerboard"};
+    const PreviewMode modes[] = {FULL_RESOLUTION, HALF_RESOLUTION, CHECKERBOARD};
+    for (int i = 0; i < 3; i++)
+    {
+        if (value == names[i])
+        {
+            result = modes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseFloat(const std::string &value, float &result)
+{
+    char* end;
+    result = strtof(value.c_str(), &end);
+    return !value.empty() && !*end;
+}
+
+// whether a request may have the image written to path: only a relative path that
+// doesn't climb out of the directory it is relative to, and only when the server has an
+// output directory or listens where only local users can connect
+static bool allowedOutput(SceneRegistry &registry, const std::string &path)
+{
+    if (!registry.outputDirectory && !registry.local)
+        return false;
+    if (path.empty() || path[0] == '/')
+        return false;
+    
+    std::istringstream parts(path);
+    std::string part;
+    while (std::getline(parts, part, '/'))
+    {
+        if (part == "..")
+            return false;
+    }
+    return true;
+}
+
+// draws the image a request line asks for and sends the answer. returns false if the
+// connection failed.
+static bool handleRequest(int fd, SceneRegistry &registry, const std::string &request)
+{
+    RenderDefaults settings = registry.defaults;
+    std::string sceneName = registry.scenes[0].name;
+    std::string output;
+    // view plane overrides, applied to a copy of the scene once it is known
+    std::map<std::string, float> view;
+    
+    std::istringstream words(request);
+    std::string word;
+    while (words >> word)
+    {
+        size_t equals = word.find('=');
+        if (equals == std::string::npos)
+            return sendLine(fd, "ERROR expected key=value, got " + word);
+        
+        std::string key = word.substr(0, equals);
+        std::string value = word.substr(equals + 1);
+        int ortho = settings.orthographic;
+        float coordinate;
+        bool ok = true;
+        
+        if (key == "scene")
+            sceneName = value;
+        else if (key == "output")
+        {
+            if (!allowedOutput(registry, value))
+                return sendLine(fd, "ERROR output not allowed: " + value);
+            output = value;
+        }
+        else if (key == "width")
+            ok = parseInt(value, 1, MAX_IMAGE_SIZE, settings.width);
+        else if (key == "height")
+            ok = parseInt(value, 1, MAX_IMAGE_SIZE, settings.height);
+        else if (key == "aa")
+            ok = parseInt(value, 1, 16, settings.antialiasFactor);
+        else if (key == "depth")
+            ok = parseInt(value, 0, 64, settings.maxDepth);
+        else if (key == "pattern")
+            ok = parsePattern(value, settings.samplePattern);
+        else if (key == "preview")
+            ok = parsePreview(value, settings.previewMode);
+        else if (key == "ortho")
+        {
+            ok = parseInt(value, 0, 1, ortho);
+            settings.orthographic = ortho;
+        }
+        else if (key == "top" || key == "bottom" || key == "left" || key == "right" || key == "z")
+        {
+            ok = parseFloat(value, coordinate);
+            view[key] = coordinate;
+        }
+        else
+            return sendLine(fd, "ERROR unknown key " + key);
+        
+        if (!ok)
+            return sendLine(fd, "ERROR bad value for " + key);
+    }
+    
+    Scene* cached = findScene(registry, sceneName);
+    if (!cached)
+        return sendLine(fd, "ERROR no scene called " + sceneName);
+    
+    // the copy shares the objects and lights, which drawing doesn't change
+    Scene scene = *cached;
+    if (view.count("top"))    scene.viewPlaneTop    = view["top"];
+    if (view.count("bottom")) scene.viewPlaneBottom = view["bottom"];
+    if (view.count("left"))   scene.viewPlaneLeft   = view["left"];
+    if (view.count("right"))  scene.viewPlaneRight  = view["right"];
+    if (view.count("z"))      scene.viewPlaneZ      = view["z"];
+    
+    // drawn on all cores
+    vector<unsigned char> canvas((size_t) settings.width * settings.height * 3);
+    drawScenePreview(&scene, &canvas[0], settings.width, settings.height, settings.maxDepth, settings.orthographic,
+                     settings.antialiasFactor, settings.previewMode, settings.samplePattern);
+    
+    if (!output.empty())
+    {
+        std::string path = registry.outputDirectory ? std::string(registry.outputDirectory) + "/" + output : output;
+        unsigned error = lodepng_encode24_file(path.c_str(), &canvas[0], settings.width, settings.height);
+        if (error)
+            return sendLine(fd, std::string("ERROR ") + lodepng_error_text(error));
+        return sendLine(fd, "OK " + output);
+    }
+    
+    unsigned char* png;
+    size_t pngSize;
+    unsigned error = lodepng_encode24(&png, &pngSize, &canvas[0], settings.width, settings.height);
+    if (error)
+        return sendLine(fd, std::string("ERROR ") + lodepng_error_text(error));
+    
+    bool sent = sendLine(fd, "PNG " + std::to_string(pngSize)) && sendAll(fd, png, pngSize);
+    free(png);
+    return sent;
+}
+
+static void serveClient(int fd, SceneRegistry* registry)
+{
+    std::string request;
+    while (readLine(fd, request) && handleRequest(fd, *registry, request))
+        ;
+    close(fd);
+}
+
+bool runRenderServer(const char* address, const NamedScene* scenes, int numScenes, RenderDefaults defaults,
+                     const char* outputDirectory)
+{
+    if (numScenes < 1)
+        return false;
+    
+    int listener = listenOn(address);
+    if (listener < 0)
+        return false;
+    
+    // lives as long as the process, since client threads are never joined
+    SceneRegistry* registry = new SceneRegistry;
+    registry->scenes = scenes;
+    registry->numScenes = numScenes;
+    registry->defaults = defaults;
+    registry->outputDirectory = outputDirectory;
+    
+    struct sockaddr_storage bound;
+    socklen_t length = sizeof(bound);
+    registry->local = getsockname(listener, (struct sockaddr*) &bound, &length) == 0 && bound.ss_family == AF_UNIX;
+    
+    for (;;)
+    {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0)
+            std::thread(serveClient, fd, registry).detach();
+    }
+}
@@ -1,151 +1,693 @@
 #include <trace.h>
+#include <incremental.h>
+#include <parallel.h>
+#include <algorithm>
 #include <cmath>
+#include <unordered_map>
 
-void drawScene(Scene* scene, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic, int antialias)
+void drawScene(Scene* scene, unsigned char* buffer, int width, int height, int maxDepth, bool orthographic, int antialias,
+               SamplePattern pattern, PixelFilter filter)
 {
-    float viewWidth, viewHeight, pixWidth, pixHeight, pixWidthOverK, pixHeightOverK;
-    int k = antialias + 1, d = antialias * antialias;
+    drawSceneRows(scene, buffer, width, height, 0, height, maxDepth, orthographic, antialias, pattern, filter);
+}
+
+PixelSampler::PixelSampler(Scene* scene, int width, int height, int maxDepth, bool orthographic, int antialias,
+                           SamplePattern pattern, TraceRecorder* recorder)
+    : camera(scene, width, height, orthographic, antialias)
+{
+    this->scene = scene;
+    this->recorder = recorder;
+    this->maxDepth = maxDepth;
+    this->pattern = pattern;
     
-    viewWidth  = scene->viewPlaneRight - scene->viewPlaneLeft;
-    viewHeight = scene->viewPlaneTop   - scene->viewPlaneBottom;
-    pixWidth  = (viewWidth  / width );
-    pixHeight = (viewHeight / height);
-    pixWidthOverK  = pixWidth  / k;
-    pixHeightOverK = pixHeight / k;
+    k = antialias + 1;
+    d = antialias * antialias;
+}
+
+// mixes the bits of a number, for hashing. (the finalizer of MurmurHash3)
+static inline unsigned mixBits(unsigned h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// a random number from 0 to 1 that depends only on the pixel and n
+static inline float pixelRandom(int x, int y, unsigned n)
+{
+    unsigned h = mixBits(mixBits(mixBits(x) ^ (unsigned) y) + n);
+    return (h >> 8) * (1.0f / (1 << 24));
+}
+
+// the fractional part of a number, for wrapping sample positions around the pixel
+static inline float wrap(float a)
+{
+    a -= floorf(a);
+    return a < 1 ? a : 0;
+}
+
+// the radical inverse of n in base 2: its bits mirrored around the binary point
+static inline float vanDerCorput(unsigned n)
+{
+    n = (n << 16) | (n >> 16);
+    n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+    n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+    n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+    n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+    return (n >> 8) * (1.0f / (1 << 24));
+}
+
+// the second dimension of the Sobol sequence
+static inline float sobol2(unsigned n)
+{
+    unsigned result = 0;
+    for (unsigned v = 1u << 31; n; n >>= 1, v ^= v >> 1)
+    {
+        if (n & 1)
+            result ^= v;
+    }
+    return (result >> 8) * (1.0f / (1 << 24));
+}
+
+// the radical inverse of n in base 3
+static inline float radicalInverse3(unsigned n)
+{
+    float result = 0;
+    float digit = 1.0f / 3;
+    for (; n; n /= 3, digit /= 3)
+        result += (n % 3) * digit;
+    return result;
+}
+
+void PixelSampler::sampleOffset(int x, int y, int sample, float &u, float &v)
+{
+    int n = k - 1;
+    int row = sample / n;
+    int col = sample % n;
     
-    float pixBottom, pixLeft;
-    Point pixelLoc(0, 0, scene->viewPlaneZ);
-    Point viewpoint(0, 0, 0);
+    switch (pattern)
+    {
+        case JITTERED_SAMPLES:
+            u = (col + pixelRandom(x, y, 2 * sample)) / n;
+            v = (row + pixelRandom(x, y, 2 * sample + 1)) / n;
+            break;
+        
+        case ROTATED_GRID_SAMPLES:
+        {
+            // cos and sin of atan(1/2)
+            const float c = 0.894427191f, s = 0.447213595f;
+            float cu = (col + 0.5f) / n - 0.5f;
+            float cv = (row + 0.5f) / n - 0.5f;
+            u = wrap(0.5f + c * cu - s * cv);
+            v = wrap(0.5f + s * cu + c * cv);
+            break;
+        }
+        
+        case HALTON_SAMPLES:
+            u = wrap(vanDerCorput(sample) + pixelRandom(x, y, 0));
+            v = wrap(radicalInverse3(sample) + pixelRandom(x, y, 1));
+            break;
+        
+        case SOBOL_SAMPLES:
+            u = wrap(vanDerCorput(sample) + pixelRandom(x, y, 0));
+            v = wrap(sobol2(sample) + pixelRandom(x, y, 1));
+            break;
+        
+        default:
+            u = (col + 1.0f) / k;
+            v = (row + 1.0f) / k;
+            break;
+    }
+}
+
+void PixelSampler::samplePoint(int x, int y, int sample, float &planeX, float &planeY)
+{
+    if (pattern == REGULAR_SAMPLES)
+    {
+        // sample (i, j) of the grid, for i and j from 1 to k - 1
+        planeY = camera.sampleY(y, sample / (k - 1) + 1);
+        planeX = camera.sampleX(x, sample % (k - 1) + 1);
+    }
+    else
+    {
+        float u, v;
+        sampleOffset(x, y, sample, u, v);
+        planeY = camera.rowBottom(y) + (v * camera.pixelHeight());
+        planeX = camera.columnLeft(x) + (u * camera.pixelWidth());
+    }
+}
+
+void PixelSampler::primaryRay(int x, int y, int sample, Ray &r)
+{
+    float planeX, planeY;
+    samplePoint(x, y, sample, planeX, planeY);
+    camera.makeRays(&planeX, &planeY, 1, &r);
+}
+
+void PixelSampler::drawAt(float x, float y, Color &c, PrimaryHit* hit)
+{
+    float planeX = scene->viewPlaneLeft + (camera.pixelWidth() * x);
+    float planeY = scene->viewPlaneBottom + (camera.pixelHeight() * y);
+    Ray r;
+    camera.makeRays(&planeX, &planeY, 1, &r);
+    trace(scene, &r, maxDepth, c, hit, recorder);
+}
+
+void PixelSampler::findHitAt(float x, float y, PrimaryHit &hit)
+{
+    float planeX = scene->viewPlaneLeft + (camera.pixelWidth() * x);
+    float planeY = scene->viewPlaneBottom + (camera.pixelHeight() * y);
+    Ray r;
+    camera.makeRays(&planeX, &planeY, 1, &r);
+    findFirstHit(scene, &r, hit);
+}
+
+void PixelSampler::findPrimaryHit(int x, int y, PrimaryHit &hit)
+{
+    float planeX = scene->viewPlaneLeft + (camera.pixelWidth() * (x + 0.5f));
+    float planeY = scene->viewPlaneBottom + (camera.pixelHeight() * (y + 0.5f));
+    Ray r;
+    camera.makeRays(&planeX, &planeY, 1, &r);
     
-    for (int y = 0; y < height; y++) 
+    Intersection* intersection = findFirstIntersection(scene, &r);
+    hit.object = NULL;
+    if (intersection)
+    {
+        hit.object = intersection->object;
+        hit.t = intersection->t;
+        hit.point = intersection->point;
+        intersection->getNormal(hit.normal);
+        delete intersection;
+    }
+}
+
+void PixelSampler::findCenterHit(int x, int y, PrimaryHit &hit)
+{
+    Ray r;
+    primaryRay(x, y, centerSample(x, y), r);
+    findFirstHit(scene, &r, hit);
+}
+
+void PixelSampler::shadePixel(int x, int y, const PrimaryHit &centerHit, Color &pixelColor)
+{
+    int center = centerSample(x, y);
+    pixelColor = Color(0,0,0);
+    
+    // the samples in the order drawPixel adds them, so the sum rounds the same way
+    for (int sample = 0; sample < d; sample++)
+    {
+        Ray r;
+        primaryRay(x, y, sample, r);
+        Color tempColor;
+        if (sample == center)
+            shade(scene, &r, centerHit, maxDepth, tempColor);
+        else
+            trace(scene, &r, maxDepth, tempColor, NULL, recorder);
+        pixelColor += tempColor;
+    }
+    
+    pixelColor.r /= d;
+    pixelColor.g /= d;
+    pixelColor.b /= d;
+}
+
+int PixelSampler::centerSample(int x, int y)
+{
+    if (pattern == REGULAR_SAMPLES)
+        return (k / 2 - 1) * (k - 1) + (k / 2 - 1);
+    
+    int closest = 0;
+    float closestDistance = 1;
+    for (int sample = 0; sample < d; sample++)
+    {
+        float u, v;
+        sampleOffset(x, y, sample, u, v);
+        float distance = (u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f);
+        if (distance < closestDistance)
+        {
+            closest = sample;
+            closestDistance = distance;
+        }
+    }
+    return closest;
+}
+
+void PixelSampler::drawPixel(int x, int y, Color &pixelColor, PrimaryHit* hit)
+{
+    drawPixels(x, y, 1, &pixelColor, hit);
+}
+
+void PixelSampler::drawPixels(int x, int y, int count, Color* colors, PrimaryHit* hits)
+{
+    // the rays of all the pixels, in order, are made RAY_BATCH at a time, so a batch
+    // can hold the last samples of one pixel and the first of the next
+    float planeX[RAY_BATCH], planeY[RAY_BATCH];
+    Ray rays[RAY_BATCH];
+    int pixels[RAY_BATCH];
+    bool reportsHit[RAY_BATCH];
+    int batched = 0;
+    
+    for (int i = 0; i < count; i++)
     {
-        pixBottom = scene->viewPlaneBottom + (pixHeight * y);
+        colors[i] = Color(0,0,0);
         
-        for (int x = 0; x < width; x++) 
+        // the ray nearest the center of the pixel reports what it hit
+        int center = hits ? centerSample(x + i, y) : -1;
+        
+        for (int sample = 0; sample < d; sample++)
         {
-            pixLeft = scene->viewPlaneLeft + (pixWidth * x);
-            Color pixelColor(0,0,0);
+            samplePoint(x + i, y, sample, planeX[batched], planeY[batched]);
+            pixels[batched] = i;
+            reportsHit[batched] = sample == center;
+            batched++;
             
-            for (int i = 1; i < k; ++i)
+            if (batched < RAY_BATCH && !(i == count - 1 && sample == d - 1))
+                continue;
+            
+            camera.makeRays(planeX, planeY, batched, rays);
+            for (int n = 0; n < batched; n++)
             {
-                pixelLoc.y = pixBottom + (i * pixHeightOverK);
+                Color tempColor;
+                trace(scene, &rays[n], maxDepth, tempColor, reportsHit[n] ? &hits[pixels[n]] : NULL, recorder);
+                colors[pixels[n]] += tempColor;
+            }
+            batched = 0;
+        }
+    }
+    
+    for (int i = 0; i < count; i++)
+    {
+        colors[i].r /= d;
+        colors[i].g /= d;
+        colors[i].b /= d;
+    }
+}
+
+void PixelSampler::drawSample(int x, int y, int sample, Color &c)
+{
+    Ray r;
+    primaryRay(x, y, sample, r);
+    trace(scene, &r, maxDepth, c, NULL, recorder);
+}
+
+// how far from the pixel center a filter reaches, in pixels
+static float filterRadius(PixelFilter filter)
+{
+    return filter == MITCHELL_FILTER ? 2 : 1;
+}
+
+// the weight of a sample dx pixels from the center of a pixel, in one direction
+static float filterWeight(PixelFilter filter, float dx)
+{
+    float x = fabsf(dx);
+    
+    if (filter == MITCHELL_FILTER)
+    {
+        const float B = 1.0f / 3, C = 1.0f / 3;
+        if (x < 1)
+            return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6;
+        if (x < 2)
+            return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6;
+        return 0;
+    }
+    
+    return x < 1 ? 1 - x : 0;
+}
+
+/**
+ * Loads the filtered colors of the tileWidth x tileHeight pixels from column left and
+ * view plane row bottom into out, bottom row first. The lattice samples are at
+ * (a / n, b / n) pixels from the bottom left corner of the view plane for whole numbers
+ * a and b, limited to the image, so every tile that needs a sample traces exactly the
+ * same ray for it.
+ */
+static void drawFilteredPixels(PixelSampler &sampler, int width, int height, int left, int bottom,
+                               int tileWidth, int tileHeight, int n, PixelFilter filter, Color* out)
+{
+    float radius = filterRadius(filter);
+    int aMin = std::max(0, (int) floorf((left + 0.5f - radius) * n));
+    int aMax = std::min(width * n, (int) ceilf((left + tileWidth - 0.5f + radius) * n));
+    int bMin = std::max(0, (int) floorf((bottom + 0.5f - radius) * n));
+    int bMax = std::min(height * n, (int) ceilf((bottom + tileHeight - 0.5f + radius) * n));
+    
+    int across = aMax - aMin + 1;
+    vector<Color> samples((size_t) across * (bMax - bMin + 1));
+    for (int b = bMin; b <= bMax; b++)
+        for (int a = aMin; a <= aMax; a++)
+            sampler.drawAt((float) a / n, (float) b / n, samples[(size_t) (b - bMin) * across + (a - aMin)]);
+    
+    for (int y = bottom; y < bottom + tileHeight; y++)
+    {
+        int b0 = std::max(bMin, (int) floorf((y + 0.5f - radius) * n));
+        int b1 = std::min(bMax, (int) ceilf((y + 0.5f + radius) * n));
+        
+        for (int x = left; x < left + tileWidth; x++)
+        {
+            int a0 = std::max(aMin, (int) floorf((x + 0.5f - radius) * n));
+            int a1 = std::min(aMax, (int) ceilf((x + 0.5f + radius) * n));
+            
+            Color sum;
+            float total = 0;
+            for (int b = b0; b <= b1; b++)
+            {
+                float wy = filterWeight(filter, (float) b / n - (y + 0.5f));
+                if (wy == 0)
+                    continue;
                 
-                for (int j = 1; j < k; ++j)
+                for (int a = a0; a <= a1; a++)
                 {
-                    pixelLoc.x = pixLeft + (j * pixWidthOverK);
-                    
-                    Ray r;
-                    r.origin = pixelLoc;
-                    if (orthographic)
-                        r.direction = Vector(0,0,-1);
-                    else
-                        r.direction = (pixelLoc - viewpoint).normalize();
-                    
-                    Color tempColor;
-                    trace(scene, &r, maxDepth, tempColor);
-                    pixelColor += tempColor;
+                    float w = wy * filterWeight(filter, (float) a / n - (x + 0.5f));
+                    sum += w * samples[(size_t) (b - bMin) * across + (a - aMin)];
+                    total += w;
                 }
             }
             
-            pixelColor.r /= d;
-            pixelColor.g /= d;
-            pixelColor.b /= d;
-            pixelColor.clampThis();
+            // at the image borders part of the filter is missing, so normalize by what's there
+            out[(size_t) (y - bottom) * tileWidth + (x - left)] = (1 / total) * sum;
+        }
+    }
+}
+
+void drawSceneRows(Scene* scene, unsigned char* buffer, int width, int height, int firstRow, int numRows,
+                   int maxDepth, bool orthographic, int antialias, SamplePattern pattern, PixelFilter filter)
+{
+    drawSceneTile(scene, buffer, width, height, 0, firstRow, width, numRows, maxDepth, orthographic, antialias,
+                  pattern, filter);
+}
+
+void drawSceneTile(Scene* scene, unsigned char* buffer, int width, int height,
+                   int left, int top, int tileWidth, int tileHeight,
+                   int maxDepth, bool orthographic, int antialias, SamplePattern pattern, PixelFilter filter)
+{
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialias, pattern);
+    
+    if (filter != BOX_FILTER)
+    {
+        vector<Color> colors((size_t) tileWidth * std::min(tileHeight, FILTER_BAND_HEIGHT));
+        
+        for (int bandTop = top; bandTop < top + tileHeight; bandTop += FILTER_BAND_HEIGHT)
+        {
+            int bandHeight = std::min(FILTER_BAND_HEIGHT, top + tileHeight - bandTop);
+            int bottom = height - (bandTop + bandHeight);
+            drawFilteredPixels(sampler, width, height, left, bottom, tileWidth, bandHeight, antialias, filter, &colors[0]);
             
+            // colors are bottom row first, the buffer top row first
+            for (int row = bandTop; row < bandTop + bandHeight; row++)
+            {
+                const Color* in = &colors[(size_t) (bandHeight - 1 - (row - bandTop)) * tileWidth];
+                for (int x = 0; x < tileWidth; x++)
+                    quantizePixel(in[x], buffer + ((size_t) (row - top) * tileWidth + x) * 3);
+            }
+        }
+        return;
+    }
+    
+    vector<Color> colors(tileWidth);
+    for (int row = top; row < top + tileHeight; row++) 
+    {
+        // rows count down from the top of the image, y counts up from the bottom of the view plane
+        int y = height - row - 1;
+        
+        sampler.drawPixels(left, y, tileWidth, &colors[0]);
+        
+        for (int x = 0; x < tileWidth; x++) 
+        {
             // lodepng actually wants this upside down
-            int bufIdx = ((height - y - 1) * width + x) * 3;
-            buffer[bufIdx + 0] = (unsigned char) (pixelColor.r * 255);
-            buffer[bufIdx + 1] = (unsigned char) (pixelColor.g * 255);
-            buffer[bufIdx + 2] = (unsigned char) (pixelColor.b * 255);
+            size_t bufIdx = ((size_t) (row - top) * tileWidth + x) * 3;
+            quantizePixel(colors[x], buffer + bufIdx);
         }
     }
 }
 
-#define isZero(color) ((color).r == 0 && (color).g == 0 && (color).b == 0)
+CropWindow cropToViewPlane(Scene* scene, int width, int height, float left, float right, float bottom, float top)
+{
+    float pixWidth  = (scene->viewPlaneRight - scene->viewPlaneLeft) / width;
+    float pixHeight = (scene->viewPlaneTop - scene->viewPlaneBottom) / height;
+    
+    // pixel x covers viewPlaneLeft + x * pixWidth to viewPlaneLeft + (x + 1) * pixWidth,
+    // and y counts up from the bottom
+    int x0 = std::max(0, (int) floorf((left - scene->viewPlaneLeft) / pixWidth));
+    int x1 = std::min(width, (int) ceilf((right - scene->viewPlaneLeft) / pixWidth));
+    int y0 = std::max(0, (int) floorf((bottom - scene->viewPlaneBottom) / pixHeight));
+    int y1 = std::min(height, (int) ceilf((top - scene->viewPlaneBottom) / pixHeight));
+    
+    CropWindow crop;
+    crop.left = x0;
+    crop.top = height - std::max(y0, y1);
+    crop.width = std::max(0, x1 - x0);
+    crop.height = std::max(0, y1 - y0);
+    return crop;
+}
 
-void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
+// stores a primary hit in the extra outputs at pixel index idx
+static void storePrimaryHit(RenderOutputs* outputs, size_t idx, PrimaryHit &hit,
+                            std::unordered_map<GeometricObject*, int> &objectIds)
 {
-    if (maxDepth <= 0)
+    bool isHit = hit.object != NULL;
+    
+    if (outputs->depth)
+        outputs->depth[idx] = isHit ? hit.t : INFINITY;
+    
+    if (outputs->normal)
     {
-        color = scene->backgroundColor;
-        return;
+        Vector n = isHit ? hit.normal : Vector(0,0,0);
+        outputs->normal[idx * 3 + 0] = n.x;
+        outputs->normal[idx * 3 + 1] = n.y;
+        outputs->normal[idx * 3 + 2] = n.z;
     }
     
-    /*****************************************************
-     ************* INTERSECTION CALCULATIONS *************
-     *****************************************************/
+    if (outputs->objectId)
+        outputs->objectId[idx] = isHit ? objectIds[hit.object] : 0;
     
-    Intersection* intersection = findFirstIntersection(scene, ray);
+    if (outputs->albedo)
+    {
+        Color a = isHit ? hit.material.diffuse : Color(0,0,0);
+        outputs->albedo[idx * 3 + 0] = a.r;
+        outputs->albedo[idx * 3 + 1] = a.g;
+        outputs->albedo[idx * 3 + 2] = a.b;
+    }
+}
+
+void drawSceneHDR(Scene* scene, float* buffer, int width, int height, int maxDepth, bool orthographic, int antialias,
+                  RenderOutputs* outputs, SamplePattern pattern, PixelFilter filter)
+{
+    PixelSampler sampler(scene, width, height, maxDepth, orthographic, antialias, pattern);
     
-    if (!intersection) 
+    // ids are the position in the object list plus one, so 0 can mean nothing was hit
+    std::unordered_map<GeometricObject*, int> objectIds;
+    if (outputs && outputs->objectId)
     {
-        // no intersection with an object, so we check to see if the ray 
-        // is pointing at a light source
-        
-        // start with point sources since they are "closer" than directional sources
-        Color closestColor;
-        float closestPoint = -1;
+        for (size_t i = 0; i < scene->objects.size(); i++)
+            objectIds[scene->objects[i]] = i + 1;
+    }
+    
+    if (filter != BOX_FILTER)
+    {
+        vector<Color> colors((size_t) width * FILTER_BAND_HEIGHT);
         
-        for (vector<PointLight*>::iterator it = scene->pointLights.begin(); 
-             it != scene->pointLights.end(); ++it)
+        for (int bottom = 0; bottom < height; bottom += FILTER_BAND_HEIGHT)
         {
-            PointLight* light = *it;
-            
-            // find potential intersection between ray and point
-            float t = (light->location.x - ray->origin.x) / ray->direction.x;
+            int bandHeight = std::min(FILTER_BAND_HEIGHT, height - bottom);
+            drawFilteredPixels(sampler, width, height, 0, bottom, width, bandHeight, antialias, filter, &colors[0]);
             
-            if (t > EPSILON && t < closestPoint)
+            for (size_t i = 0; i < (size_t) width * bandHeight; i++)
             {
-                // plug back in to see if the solution is valid for all three dimensions
-                float yVal = light->location.y - ray->origin.y - t * ray->direction.y;
-                float zVal = light->location.z - ray->origin.z - t * ray->direction.z;
-                bool yValCheck = yVal == 0;
-                bool zValCheck = zVal == 0;
-                
-                if (yValCheck && zValCheck)
-                {
-                    closestPoint = t;
-                    closestColor = light->color;
-                }
+                size_t idx = (size_t) bottom * width + i;
+                buffer[idx * 3 + 0] = colors[i].r;
+                buffer[idx * 3 + 1] = colors[i].g;
+                buffer[idx * 3 + 2] = colors[i].b;
             }
         }
         
-        if (closestPoint >= 0)
-        {
-            color = closestColor;
+        if (!outputs)
             return;
-        }
+    }
+    
+    vector<Color> colors(width);
+    vector<PrimaryHit> hits(width);
+    for (int y = 0; y < height; y++) 
+    {
+        if (filter == BOX_FILTER)
+            sampler.drawPixels(0, y, width, &colors[0], outputs ? &hits[0] : NULL);
         
-        // now check directional sources
-        for (vector<DirectionalLight*>::iterator it = scene->directionalLights.begin(); 
-             it != scene->directionalLights.end(); ++it)
+        for (int x = 0; x < width; x++) 
         {
-            DirectionalLight* light = *it;
-            float angleCos = dot(ray->direction, light->direction);
-            if (angleCos == -1) \
+            size_t idx = (size_t) y * width + x;
+            
+            if (filter == BOX_FILTER)
             {
-                // ray is pointing towards directional light
-                color = light->color;
-                return;
+                buffer[idx * 3 + 0] = colors[x].r;
+                buffer[idx * 3 + 1] = colors[x].g;
+                buffer[idx * 3 + 2] = colors[x].b;
             }
+            else
+                sampler.findHitAt(x + 0.5f, y + 0.5f, hits[x]);
+            
+            if (outputs)
+                storePrimaryHit(outputs, idx, hits[x], objectIds);
         }
+    }
+}
+
+void quantizeHDR(const float* hdr, unsigned char* buffer, int width, int height)
+{
+    // rows are independent, so split them between all cores
+    parallelFor(0, height, [&](int y)
+    {
+        const float* in = hdr + (size_t) y * width * 3;
+        unsigned char* out = buffer + (size_t) (height - y - 1) * width * 3;
+        
+        for (int x = 0; x < width; x++)
+            quantizePixel(Color(in[x * 3 + 0], in[x * 3 + 1], in[x * 3 + 2]), out + x * 3);
+    });
+}
+
+#define isZero(color) ((color).r == 0 && (color).g == 0 && (color).b == 0)
+
+static void traceShadow(Scene* scene, Ray* shadow, float lightT, int maxDepth, Color &result,
+                        TraceRecorder* recorder, int light);
+static void shadeSurface(Scene* scene, Ray* ray, const PrimaryHit &surface, int maxDepth, Color &color,
+                         TraceRecorder* recorder, int lights);
+
+// whether a color computed for lights includes the parts that don't depend on point lights
+#define hasUnlitPart(lights) ((lights) < 0)
+// whether it includes what point light number i contributes
+#define hasLight(lights, i) ((lights) == ALL_LIGHTS || (lights) == (i))
+
+// the color of a ray that hit nothing, for lights
+static void shadeMiss(Scene* scene, Ray* ray, Color &color, int lights)
+{
+    // no intersection with an object, so we check to see if the ray 
+    // is pointing at a light source
+    
+    // start with point sources since they are "closer" than directional sources
+    Color closestColor;
+    float closestPoint = -1;
+    int closestLight = -1;
+    
+    for (vector<PointLight*>::iterator it = scene->pointLights.begin(); 
+         it != scene->pointLights.end(); ++it)
+    {
+        PointLight* light = *it;
         
-        // no light sources, just return background
-        color = scene->backgroundColor;
+        // find potential intersection between ray and point
+        float t = (light->location.x - ray->origin.x) / ray->direction.x;
+        
+        if (t > EPSILON && t < closestPoint)
+        {
+            // plug back in to see if the solution is valid for all three dimensions
+            float yVal = light->location.y - ray->origin.y - t * ray->direction.y;
+            float zVal = light->location.z - ray->origin.z - t * ray->direction.z;
+            bool yValCheck = yVal == 0;
+            bool zValCheck = zVal == 0;
+            
+            if (yValCheck && zValCheck)
+            {
+                closestPoint = t;
+                closestColor = light->color;
+                closestLight = it - scene->pointLights.begin();
+            }
+        }
+    }
+    
+    if (closestPoint >= 0)
+    {
+        if (lights == ALL_LIGHTS)
+            color = closestColor;
+        else
+            color = lights == closestLight ? Color(1,1,1) : Color(0,0,0);
+        return;
+    }
+    
+    color = Color(0,0,0);
+    if (!hasUnlitPart(lights))
+        return;
+    
+    // now check directional sources
+    for (vector<DirectionalLight*>::iterator it = scene->directionalLights.begin(); 
+         it != scene->directionalLights.end(); ++it)
+    {
+        DirectionalLight* light = *it;
+        float angleCos = dot(ray->direction, light->direction);
+        if (angleCos == -1) \
+        {
+            // ray is pointing towards directional light
+            color = light->color;
+            return;
+        }
+    }
+    
+    // no light sources, just return background
+    color = scene->backgroundColor;
+}
+
+static void loadHit(Intersection* intersection, PrimaryHit &hit)
+{
+    hit.object = intersection->object;
+    hit.t = intersection->t;
+    hit.point = intersection->point;
+    intersection->getNormal(hit.normal);
+    intersection->getMaterial(hit.material);
+}
+
+// trace, where primary says whether the ray comes from the view plane, for the recorder,
+// and lights picks the part of the color to compute as for shade
+static void traceRay(Scene* scene, Ray* ray, int maxDepth, Color &color, PrimaryHit* hit, TraceRecorder* recorder,
+                     bool primary, int lights)
+{
+    if (hit)
+        hit->object = NULL;
+    
+    if (maxDepth <= 0)
+    {
+        color = hasUnlitPart(lights) ? scene->backgroundColor : Color(0,0,0);
         return;
     }
     
     /*****************************************************
-     *************** LIGHTING CALCULATIONS ***************
+     ************* INTERSECTION CALCULATIONS *************
      *****************************************************/
     
-    Material material;
-    Vector normal;
-    Point point;
+    Intersection* intersection = findFirstIntersection(scene, ray);
+    
+    if (recorder)
+    {
+        recorder->recordSegment(primary ? PRIMARY_RAYS : SECONDARY_RAYS, ray->origin, ray->direction,
+                                intersection ? intersection->t : INFINITY);
+        if (intersection)
+            recorder->recordHit(intersection->object);
+    }
+    
+    if (!intersection) 
+    {
+        shadeMiss(scene, ray, color, lights);
+        return;
+    }
+    
+    PrimaryHit surface;
+    loadHit(intersection, surface);
+    delete intersection;
+    
+    if (hit)
+        *hit = surface;
     
-    point = intersection->point;
-    intersection->getNormal(normal);
-    intersection->getMaterial(material);
+    shadeSurface(scene, ray, surface, maxDepth, color, recorder, lights);
+}
+
+// the lighting calculations of trace, for a ray that hit surface
+static void shadeSurface(Scene* scene, Ray* ray, const PrimaryHit &surface, int maxDepth, Color &color,
+                         TraceRecorder* recorder, int lights)
+{
+    /*****************************************************
+     *************** LIGHTING CALCULATIONS ***************
+     *****************************************************/
+    
+    const Material &material = surface.material;
+    const Vector &normal = surface.normal;
+    Point point = surface.point;
     
     // initialize color to 0
     color = Color(0,0,0);
@@ -158,13 +700,14 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
      ****************** COMPUTE AMBIENT ******************
      *****************************************************/
     
-    color += material.ambient * scene->ambientLight;
+    if (hasUnlitPart(lights))
+        color += material.ambient * scene->ambientLight;
     
     /*****************************************************
      ******************* COMPUTE LOCAL *******************
      *****************************************************/
     
-    if (hasDiffuse || hasSpecular)
+    if ((hasDiffuse || hasSpecular) && lights != NO_LIGHTS)
     {
         Color diffuse(0,0,0);
         Color specular(0,0,0);
@@ -175,6 +718,17 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
              it != scene->pointLights.end(); ++it)
         {
             PointLight* light = *it;
+            int lightIndex = it - scene->pointLights.begin();
+            if (!hasLight(lights, lightIndex))
+                continue;
+            
+            // a single light's part is for a white light, to be scaled by its color later
+            Color lightColor = lights == ALL_LIGHTS ? light->color : Color(1,1,1);
+            
+            // moving the light could turn the object towards it, so the color depends on
+            // it either way
+            if (recorder)
+                recorder->recordLight(lightIndex);
             
             // first make sure object is facing light
             Vector toLight = (light->location - point).normalize();
@@ -187,7 +741,7 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
             Ray shadowRay;
             shadowRay.direction = light->location - point;
             shadowRay.origin = point;
-            computeShadow(scene, &shadowRay, 1, maxDepth, shadow);
+            traceShadow(scene, &shadowRay, 1, maxDepth, shadow, recorder, lightIndex);
             
             if (isZero(shadow))
                 // light is completely blocked
@@ -196,7 +750,7 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
             // compute diffuse reflection
             if (hasDiffuse)
             {
-                diffuse += angleCos * light->color * shadow;
+                diffuse += angleCos * lightColor * shadow;
             }
             
             // compute specular reflection
@@ -205,7 +759,7 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
                 Vector idealReflect = 2 * angleCos * normal - toLight;
                 float angleCos2 = dot(idealReflect, toViewer);
                 if (angleCos2 > 0)
-                    specular += pow(angleCos2, material.shininess) * light->color * shadow;
+                    specular += pow(angleCos2, material.shininess) * lightColor * shadow;
             }
         }
         
@@ -228,7 +782,7 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
         
         // use recursive call to determine the reflected color
         Color reflected;
-        trace(scene, &reflect, maxDepth - 1, reflected);
+        traceRay(scene, &reflect, maxDepth - 1, reflected, NULL, recorder, false, lights);
         
         reflected *= material.specular;
         color += reflected;
@@ -247,19 +801,51 @@ void trace(Scene* scene, Ray* ray, int maxDepth, Color &color)
         
         // use recursive call to determine the refracted color
         Color refracted;
-        trace(scene, &refractRay, maxDepth - 1, refracted);
+        traceRay(scene, &refractRay, maxDepth - 1, refracted, NULL, recorder, false, lights);
         
         refracted *= material.refracted;
         color += refracted;
     }
     
-    color += material.emission;
-    
-    delete intersection;
+    if (hasUnlitPart(lights))
+        color += material.emission;
+}
+
+void trace(Scene* scene, Ray* ray, int maxDepth, Color &color, PrimaryHit* hit, TraceRecorder* recorder)
+{
+    traceRay(scene, ray, maxDepth, color, hit, recorder, true, ALL_LIGHTS);
+}
+
+void findFirstHit(Scene* scene, Ray* ray, PrimaryHit &hit)
+{
+    Intersection* intersection = findFirstIntersection(scene, ray);
+    hit.object = NULL;
+    if (intersection)
+    {
+        loadHit(intersection, hit);
+        delete intersection;
+    }
+}
+
+void shade(Scene* scene, Ray* ray, const PrimaryHit &hit, int maxDepth, Color &color, int lights)
+{
+    if (maxDepth <= 0)
+        color = hasUnlitPart(lights) ? scene->backgroundColor : Color(0,0,0);
+    else if (!hit.object)
+        shadeMiss(scene, ray, color, lights);
+    else
+        shadeSurface(scene, ray, hit, maxDepth, color, NULL, lights);
 }
 
 // recursively computes how much of a shadow is being cast on a point relative to a particular light source
 void computeShadow(Scene* scene, Ray* shadow, float lightT, int maxDepth, Color &result)
+{
+    traceShadow(scene, shadow, lightT, maxDepth, result, NULL, 0);
+}
+
+// computeShadow, telling the recorder about the ray towards point light number light
+static void traceShadow(Scene* scene, Ray* shadow, float lightT, int maxDepth, Color &result,
+                        TraceRecorder* recorder, int light)
 {
     if (maxDepth <= 0)
     {
@@ -268,6 +854,15 @@ void computeShadow(Scene* scene, Ray* shadow, float lightT, int maxDepth, Color
     
     Intersection* inter = findFirstIntersection(scene, shadow);
     
+    // only what lies between the point and the light matters
+    if (recorder)
+    {
+        bool blocked = inter && inter->t <= lightT;
+        recorder->recordSegment(SHADOW_RAYS + light, shadow->origin, shadow->direction, blocked ? inter->t : lightT);
+        if (blocked)
+            recorder->recordHit(inter->object);
+    }
+    
     if (!inter || (lightT >= 0 && inter->t > lightT))
     {
         // no objects are between the point and the light source
@@ -286,7 +881,7 @@ void computeShadow(Scene* scene, Ray* shadow, float lightT, int maxDepth, Color
             refractRay.origin = inter->point;
             refractRay.direction = shadow->direction;
             
-            computeShadow(scene, &refractRay, lightT - inter->t, maxDepth - 1, result);
+            traceShadow(scene, &refractRay, lightT - inter->t, maxDepth - 1, result, recorder, light);
             result *= m.refracted;
         }
         else
@@ -298,6 +893,9 @@ void computeShadow(Scene* scene, Ray* shadow, float lightT, int maxDepth, Color
 
 Intersection* findFirstIntersection(Scene* scene, Ray* ray)
 {
+    if (scene->accelerator)
+        return scene->accelerator->findFirstIntersection(ray);
+    
     vector<GeometricObject*>::iterator it;
     Intersection *intersection, *closest = NULL;
     GeometricObject* object;
@@ -0,0 +1,19 @@
+#include <util.h>
+
+#include <sys/time.h>
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+std::string numberedFileName(const char* outputFile, const std::string &suffix)
+{
+    std::string name = outputFile;
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos)
+        dot = name.size();
+    return name.substr(0, dot) + suffix + name.substr(dot);
+}
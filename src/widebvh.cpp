@@ -0,0 +1,312 @@
+#include <widebvh.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#define EMPTY_CHILD INT32_MIN
+
+// where a byte across a node's box lies. the kernels below work it out in the same steps.
+static inline float dequantize(int q, float origin, float scale)
+{
+    return (float) q * scale + origin;
+}
+
+template<int Width>
+WideBVH<Width>::WideBVH(Scene* scene)
+{
+    this->scene = scene;
+    
+    BVH binary(scene);
+    order = binary.order;
+    unbounded = binary.unbounded;
+    
+    if (binary.nodes.empty())
+        return;
+    if (binary.nodes[0].count > 0)
+    {
+        // a single leaf still needs a node to hold it
+        makeNode(binary, 0, vector<int>(1, 0));
+    }
+    else
+        collapse(binary, 0);
+}
+
+template<int Width>
+int32_t WideBVH<Width>::addChild(const BVH &binary, int node)
+{
+    if (binary.nodes[node].count == 0)
+        return collapse(binary, node);
+    
+    Leaf leaf = {binary.nodes[node].first, binary.nodes[node].count};
+    leaves.push_back(leaf);
+    return ~(int32_t) (leaves.size() - 1);
+}
+
+template<int Width>
+int WideBVH<Width>::collapse(const BVH &binary, int node)
+{
+    // open up the biggest branch among the children until there are Width of them
+    vector<int> children;
+    children.push_back(node + 1);
+    children.push_back(binary.nodes[node].first);
+    while ((int) children.size() < Width)
+    {
+        int biggest = -1;
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            if (binary.nodes[children[i]].count == 0 &&
+                (biggest < 0 || area(binary.nodes[children[i]].bounds) > area(binary.nodes[children[biggest]].bounds)))
+                biggest = i;
+        }
+        if (biggest < 0)
+            break;
+        int opened = children[biggest];
+        children[biggest] = opened + 1;
+        children.push_back(binary.nodes[opened].first);
+    }
+    
+    return makeNode(binary, node, children);
+}
+
+template<int Width>
+int WideBVH<Width>::makeNode(const BVH &binary, int node, const vector<int> &children)
+{
+    int index = nodes.size();
+    nodes.push_back(Node());
+    
+    Node wide;
+    const Bounds &bounds = binary.nodes[node].bounds;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        // a scale that reaches at least to the far side of the box
+        float origin = coordinate(bounds.min, axis), max = coordinate(bounds.max, axis);
+        float scale = (max - origin) / 255;
+        while (dequantize(255, origin, scale) < max)
+            scale = nextafterf(scale, INFINITY);
+        wide.origin[axis] = origin;
+        wide.scale[axis] = scale;
+        
+        for (int i = 0; i < Width; i++)
+        {
+            if (i >= (int) children.size())
+            {
+                wide.low[axis][i] = 255;
+                wide.high[axis][i] = 0;
+                continue;
+            }
+            
+            // round outwards, checking with the same steps traversal takes
+            const Bounds &child = binary.nodes[children[i]].bounds;
+            float low = coordinate(child.min, axis), high = coordinate(child.max, axis);
+            int qLow = 0, qHigh = 0;
+            if (scale > 0)
+            {
+                qLow = std::max(0, std::min(255, (int) floorf((low - origin) / scale)));
+                qHigh = std::max(0, std::min(255, (int) ceilf((high - origin) / scale)));
+            }
+            while (qLow > 0 && dequantize(qLow, origin, scale) > low)
+                qLow--;
+            while (qHigh < 255 && dequantize(qHigh, origin, scale) < high)
+                qHigh++;
+            wide.low[axis][i] = qLow;
+            wide.high[axis][i] = qHigh;
+        }
+    }
+    
+    for (int i = 0; i < Width; i++)
+        wide.child[i] = i < (int) children.size() ? addChild(binary, children[i]) : EMPTY_CHILD;
+    nodes[index] = wide;
+    return index;
+}
+
+template<int Width>
+size_t WideBVH<Width>::memoryUsed()
+{
+    return nodes.size() * sizeof(Node) + leaves.size() * sizeof(Leaf) +
+           (order.size() + unbounded.size()) * sizeof(int);
+}
+
+// the child test one child at a time, for when there are no vector instructions for it
+template<int Width>
+static inline void enterChildrenScalar(const float* nodeOrigin, const float* scale, const uint8_t (*low)[Width],
+                                       const uint8_t (*high)[Width], const float* origin, const float* inverse,
+                                       const int* near, float limit, float* t)
+{
+    for (int i = 0; i < Width; i++)
+    {
+        float enter = -INFINITY, leave = INFINITY;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int nearSide = near[axis] ? high[axis][i] : low[axis][i];
+            int farSide = near[axis] ? low[axis][i] : high[axis][i];
+            enter = std::max(enter, (dequantize(nearSide, nodeOrigin[axis], scale[axis]) - origin[axis]) *
+                                    inverse[axis]);
+            leave = std::min(leave, (dequantize(farSide, nodeOrigin[axis], scale[axis]) - origin[axis]) *
+                                    inverse[axis]);
+        }
+        t[i] = enter <= leave && leave >= 0 && enter <= limit ? enter : INFINITY;
+    }
+}
+
+template<int Width>
+void WideBVH<Width>::enterChildren(const Node &node, const float* origin, const float* inverse, const int* near,
+                                   float limit, float* t)
+{
+    enterChildrenScalar<Width>(node.origin, node.scale, node.low, node.high, origin, inverse, near, limit, t);
+}
+
+#ifdef __SSE2__
+// four bytes as floats across a node's box
+static inline __m128 dequantize4(const uint8_t* q, float origin, float scale)
+{
+    int32_t packed;
+    memcpy(&packed, q, 4);
+    __m128i zero = _mm_setzero_si128();
+    __m128i ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints), _mm_set1_ps(scale)), _mm_set1_ps(origin));
+}
+
+template<>
+void WideBVH<4>::enterChildren(const Node &node, const float* origin, const float* inverse, const int* near,
+                               float limit, float* t)
+{
+    __m128 enter = _mm_set1_ps(-INFINITY), leave = _mm_set1_ps(INFINITY);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const uint8_t* nearSide = near[axis] ? node.high[axis] : node.low[axis];
+        const uint8_t* farSide = near[axis] ? node.low[axis] : node.high[axis];
+        __m128 o = _mm_set1_ps(origin[axis]), inv = _mm_set1_ps(inverse[axis]);
+        __m128 a = _mm_mul_ps(_mm_sub_ps(dequantize4(nearSide, node.origin[axis], node.scale[axis]), o), inv);
+        __m128 b = _mm_mul_ps(_mm_sub_ps(dequantize4(farSide, node.origin[axis], node.scale[axis]), o), inv);
+        enter = _mm_max_ps(enter, a);
+        leave = _mm_min_ps(leave, b);
+    }
+    
+    __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(enter, leave), _mm_cmpge_ps(leave, _mm_setzero_ps())),
+                            _mm_cmple_ps(enter, _mm_set1_ps(limit)));
+    _mm_storeu_ps(t, _mm_or_ps(_mm_and_ps(hit, enter), _mm_andnot_ps(hit, _mm_set1_ps(INFINITY))));
+}
+
+// eight bytes as floats across a node's box
+__attribute__((target("avx2")))
+static inline __m256 dequantize8(const uint8_t* q, float origin, float scale)
+{
+    __m256i ints = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) q));
+    return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(ints), _mm256_set1_ps(scale)), _mm256_set1_ps(origin));
+}
+
+__attribute__((target("avx2")))
+static void enterChildren8(const float* nodeOrigin, const float* scale, const uint8_t (*low)[8],
+                           const uint8_t (*high)[8], const float* origin, const float* inverse, const int* near,
+                           float limit, float* t)
+{
+    __m256 enter = _mm256_set1_ps(-INFINITY), leave = _mm256_set1_ps(INFINITY);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const uint8_t* nearSide = near[axis] ? high[axis] : low[axis];
+        const uint8_t* farSide = near[axis] ? low[axis] : high[axis];
+        __m256 o = _mm256_set1_ps(origin[axis]), inv = _mm256_set1_ps(inverse[axis]);
+        __m256 a = _mm256_mul_ps(_mm256_sub_ps(dequantize8(nearSide, nodeOrigin[axis], scale[axis]), o), inv);
+        __m256 b = _mm256_mul_ps(_mm256_sub_ps(dequantize8(farSide, nodeOrigin[axis], scale[axis]), o), inv);
+        enter = _mm256_max_ps(enter, a);
+        leave = _mm256_min_ps(leave, b);
+    }
+    
+    __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(enter, leave, _CMP_LE_OQ),
+                                             _mm256_cmp_ps(leave, _mm256_setzero_ps(), _CMP_GE_OQ)),
+                               _mm256_cmp_ps(enter, _mm256_set1_ps(limit), _CMP_LE_OQ));
+    _mm256_storeu_ps(t, _mm256_blendv_ps(_mm256_set1_ps(INFINITY), enter, hit));
+}
+
+static bool detectAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool hasAVX2 = detectAVX2();
+
+template<>
+void WideBVH<8>::enterChildren(const Node &node, const float* origin, const float* inverse, const int* near,
+                               float limit, float* t)
+{
+    if (hasAVX2)
+        enterChildren8(node.origin, node.scale, node.low, node.high, origin, inverse, near, limit, t);
+    else
+        enterChildrenScalar<8>(node.origin, node.scale, node.low, node.high, origin, inverse, near, limit, t);
+}
+#endif
+
+template<int Width>
+Intersection* WideBVH<Width>::findFirstIntersection(Ray* ray)
+{
+    Intersection* closest = NULL;
+    int closestIndex = 0;
+    
+    for (size_t i = 0; i < unbounded.size(); i++)
+        tryObject(scene, unbounded[i], ray, closest, closestIndex);
+    
+    if (nodes.empty())
+        return closest;
+    
+    float origin[3] = {ray->origin.x, ray->origin.y, ray->origin.z};
+    float inverse[3] = {reciprocal(ray->direction.x), reciprocal(ray->direction.y), reciprocal(ray->direction.z)};
+    int near[3] = {inverse[0] < 0, inverse[1] < 0, inverse[2] < 0};
+    
+    // children still to visit, with where the ray enters them
+    struct Entry {
+        int32_t child;
+        float t;
+    };
+    Entry stack[BVH_MAX_DEPTH * Width];
+    int top = 0;
+    stack[top++] = {0, 0};
+    
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+        // a box entered exactly at the closest distance may still hold an earlier object
+        if (closest && entry.t > closest->t)
+            continue;
+        
+        if (entry.child < 0)
+        {
+            const Leaf &leaf = leaves[~entry.child];
+            for (int i = leaf.first; i < leaf.first + leaf.count; i++)
+                tryObject(scene, order[i], ray, closest, closestIndex);
+            continue;
+        }
+        
+        const Node &node = nodes[entry.child];
+        float t[Width];
+        enterChildren(node, origin, inverse, near, closest ? closest->t : INFINITY, t);
+        
+        // push the children entered farthest first, so the nearest is visited next
+        Entry entered[Width];
+        int count = 0;
+        for (int i = 0; i < Width; i++)
+        {
+            if (t[i] == INFINITY || node.child[i] == EMPTY_CHILD)
+                continue;
+            int j = count++;
+            while (j > 0 && entered[j - 1].t < t[i])
+            {
+                entered[j] = entered[j - 1];
+                j--;
+            }
+            entered[j] = {node.child[i], t[i]};
+        }
+        for (int i = 0; i < count; i++)
+            stack[top++] = entered[i];
+    }
+    return closest;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;